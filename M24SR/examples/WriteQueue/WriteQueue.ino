@@ -0,0 +1,51 @@
+/*  Example: WriteQueue
+ *
+ *  Update the tag content continuously, even while a phone is reading it.
+ *  Only the newest message is kept and it is written once the RF session ends.
+ *
+ * Pinout:
+ *  -------------------------------------------------------------------------------
+ *  M24SR             -> Arduino / resistor / antenna
+ *  -------------------------------------------------------------------------------
+ *  1 RF disable      -> not used
+ *  2 AC0 (antenna)   -> Antenna
+ *  3 AC1 (antenna)   -> Antenna
+ *  4 VSS (GND)       -> Arduino Gnd
+ *  5 SDA (I2C data)  -> Arduino A4 (SDA Pin)
+ *  6 SCK (I2C clock) -> Arduino A5 (SCL Pin)
+ *  7 GPO             -> Arduino D7 + Pull-Up resistor (>4.7kOhm) to VCC
+ *  8 VCC (2...5V)    -> Arduino 3.3V
+ *  -------------------------------------------------------------------------------
+ */
+//==============================================================================
+#include <M24SR.h>
+#include <M24SRWriteQueue.h>
+//==============================================================================
+#define gpo_pin 7
+//==============================================================================
+M24SR m24sr(gpo_pin);
+M24SRWriteQueue queue(m24sr);
+unsigned long lastUpdate = 0;
+//==============================================================================
+void setup()
+{
+   Serial.begin(9600);
+   m24sr.setup();
+}
+
+void loop()
+{
+   if (millis() - lastUpdate > 500)
+   {
+      lastUpdate = millis();
+      NdefMessage message = NdefMessage();
+      message.addTextRecord(String(F("uptime ")) + String(lastUpdate / 1000) + String(F(" s")));
+      // hand the message over rather than copying it
+      queue.write(static_cast<NdefMessage&&>(message));
+   }
+
+   if (queue.update())
+   {
+      queue.print();
+   }
+}
@@ -4,11 +4,30 @@
 //==============================================================================
 #include <M24SR.h>
 //==============================================================================
+static const uint32_t busSpeeds[M24SR_I2C_SPEED_COUNT] =
+{
+    M24SR_I2C_STANDARD_MODE,
+    M24SR_I2C_FAST_MODE,
+    M24SR_I2C_FAST_MODE_PLUS
+};
+//==============================================================================
 M24SR::M24SR(uint8_t gpo)
 {
     verbose = false;
     cmds = false;
+    responseCrcValid = false;
+    responseLength = 0;
+    response = (uint8_t*)NULL;
     gpoPin = gpo;
+    busSpeed = 0;
+    paced = true;
+    busMicros = 0;
+    for (uint8_t i = 0; i < M24SR_I2C_SPEED_COUNT; ++i)
+    {
+        busThroughput[i] = 0;
+    }
+    variant = M24SR_VARIANT_UNKNOWN;
+    memorySize = 0;
 }
 //==============================================================================
 M24SR::~M24SR()
@@ -19,7 +38,7 @@ M24SR::~M24SR()
     }
 }
 //==============================================================================
-void M24SR::setup()
+uint32_t M24SR::setup(uint32_t maxBusSpeed)
 {
     if (verbose)
     {
@@ -29,12 +48,101 @@ void M24SR::setup()
     sendGetI2cSession = true;
     deviceAddress = 0x56;
     blockNo = 0;
-    responseLength = 0x15;
-    response = (byte*)malloc(responseLength);
+    if (responseLength < 0x15)
+    {
+        free(response);
+        response = (byte*)malloc(0x15);
+        responseLength = response ? 0x15 : 0;
+        if (response == NULL)
+        {
+            Serial.println(F("\r\nout of memory for response"));
+            return 0;
+        }
+    }
     
     Wire.begin(); // join i2c bus (address optional for master)
     pinMode(gpoPin, INPUT);
+    
+    // fastest first, fall back towards 100 kHz if the M24SR does not answer
+    busSpeed = 0;
+    for (int8_t i = M24SR_I2C_SPEED_COUNT - 1; i >= 0; --i)
+    {
+        if (busSpeeds[i] > maxBusSpeed)
+        {
+            continue;
+        }
+        if (probeBusSpeed(i))
+        {
+            busSpeed = busSpeeds[i];
+            break;
+        }
+    }
+    if (busSpeed == 0)
+    {
+        Serial.println(F("\r\nM24SR not responding"));
+        Wire.setClock(M24SR_I2C_STANDARD_MODE);
+        paced = true;
+        return 0;
+    }
+    
     writeGPO(0x61);
+    if (variant == M24SR_VARIANT_UNKNOWN)
+    {
+        detectVariant();
+    }
+    return busSpeed;
+}
+//==============================================================================
+boolean M24SR::probeBusSpeed(uint8_t speedIndex)
+{
+    Wire.setClock(busSpeeds[speedIndex]);
+    paced = busSpeeds[speedIndex] < M24SR_I2C_FAST_MODE;
+    
+    busMicros = 0;
+    selectFileNdefApp();
+    unsigned long elapsed = busMicros;
+    boolean answered = (err == 0) && responseCrcValid && (response[0] == 0x90) && (response[1] == 0x00);
+    sendDESELECT();
+    
+    // GetI2Csession + SELECT frame out, R-APDU in
+    const unsigned long bytes = 1 + sizeof(FRAME_SELECT_NDEF_APP[0]) + (2 + 3);
+    busThroughput[speedIndex] = (answered && elapsed) ? (bytes * 1000000UL) / elapsed : 0;
+    
+    if (verbose)
+    {
+        Serial.print(F("\r\nprobe "));
+        Serial.print(busSpeeds[speedIndex], DEC);
+        Serial.print(F(" Hz: "));
+        Serial.print(busThroughput[speedIndex], DEC);
+        Serial.print(F(" B/s"));
+    }
+    return answered;
+}
+//==============================================================================
+uint32_t M24SR::getBusSpeed()
+{
+    return busSpeed;
+}
+
+unsigned long M24SR::getBusThroughput(uint32_t speed)
+{
+    for (uint8_t i = 0; i < M24SR_I2C_SPEED_COUNT; ++i)
+    {
+        if (busSpeeds[i] == speed)
+        {
+            return busThroughput[i];
+        }
+    }
+    return 0;
+}
+void M24SR::pace(unsigned long ms)
+{
+    // Wire.write only fills a buffer, so these delays never helped the bus.
+    // They go at Fast mode and above so the faster clock pays off.
+    if (paced)
+    {
+        delay(ms);
+    }
 }
 // //==============================================================================
 void M24SR::writeGPO(uint8_t value)
@@ -49,7 +157,7 @@ void M24SR::writeGPO(uint8_t value)
         return;
     }
     
-    sendApdu_P(0x00, INS_SELECT_FILE, 0x00, 0x0C, 0x02, FILE_SYSTEM);
+    sendFrame_P(FRAME_SELECT_SYSTEM_FILE[0], sizeof(FRAME_SELECT_SYSTEM_FILE[0]));
     receiveResponse(2 + 3);
     
     sendApdu(0x00, INS_UPDATE_BINARY, 0x00, 0x04, 0x01, &value); //write system file at offset 0x0004 GPO
@@ -59,6 +167,11 @@ void M24SR::writeGPO(uint8_t value)
 
 //==============================================================================
 int M24SR::receiveResponse(unsigned int len)
+{
+    return receiveResponse(len, 0);
+}
+
+int M24SR::receiveResponse(unsigned int len, unsigned int offset)
 {
     unsigned int index = 0;
     boolean WTX = false;
@@ -69,33 +182,44 @@ int M24SR::receiveResponse(unsigned int len)
         Serial.print(len, DEC);
         Serial.println();
     }
-    if (responseLength < len)
+    if (responseLength < offset + len)
     {
-        free(response);
         if (verbose)
         {
             Serial.print(F("\r\nresponseLength="));
-            Serial.print(len, DEC);
+            Serial.print(offset + len, DEC);
         }
-        responseLength = len;
-        response = (byte*)malloc(responseLength);
+        byte* grown = (byte*)realloc(response, offset + len);
+        if (grown == NULL)
+        {
+            // the old buffer is still valid, leave it alone
+            Serial.println(F("\r\nout of memory for response"));
+            responseCrcValid = false;
+            return 0;
+        }
+        response = grown;
+        responseLength = offset + len;
     }
     else
     {
-        delay(1);
+        pace(1);
     }
+    crc16_ctx crc;
     do
     {
         WTX = false;
         loop = false;
+        crc16_init(&crc, 0x6363);
+        unsigned long start = micros();
         Wire.requestFrom(deviceAddress, len);
+        busMicros += micros() - start;
         if (cmds)
         {
             Serial.print(F("<= "));
         }
         else
         {
-            delay(1);
+            pace(1);
         }
         while ((Wire.available() &&
                 index < len &&
@@ -103,6 +227,7 @@ int M24SR::receiveResponse(unsigned int len)
                (WTX && index < len-1))
         {
             int c  = (Wire.read() & 0xff);
+            crc16_update_byte(&crc, c);
             if (cmds)
             {
                 if (c < 0x10)
@@ -114,7 +239,7 @@ int M24SR::receiveResponse(unsigned int len)
             }
             else
             {
-                delay(1);
+                pace(1);
             }
             if (c == 0xF2 && index == 0)
             {
@@ -122,75 +247,116 @@ int M24SR::receiveResponse(unsigned int len)
             }
             if (index >= 1)
             {
-                response[index-1] = c;
+                response[offset + index-1] = c;
             }
             index++;
         }
         if (WTX)
         {
             Serial.print(F("\r\nWTX"));
-            delay(200 * response[0]);
+            delay(200 * response[offset]);
             //send WTX response
             //sendSBLOCK(0xF2);
             data[0] = 0xF2; //WTX
-            data[1] = response[0];
+            data[1] = response[offset];
             sendCommand(/*data,*/ 2, false);
             loop = true;
             index = 0;
         }
     }
     while(loop);
+    responseCrcValid = (index == len) && crc16_check(&crc);
+    if (!responseCrcValid && verbose)
+    {
+        Serial.print(F("\r\nresponse CRC error"));
+    }
     return index;
 }
+
+boolean M24SR::isResponseCrcValid()
+{
+    return responseCrcValid;
+}
 //==============================================================================
 /*
  end of a I2c Session:
  5.4 S-Block format
  0xC2: for S(DES) when the DID field is not present
  */
-void M24SR::sendDESELECT()
+void M24SR::sendDESELECT(unsigned int responseOffset)
 {
     if (verbose)
     {
         Serial.print(F("\r\nsend DESELECT"));
     }
-    sendSBLOCK(0xC2);//PCB field
+    sendSBLOCK(0xC2, responseOffset);//PCB field
 }
 
-void M24SR::sendSBLOCK(byte sblock)
+void M24SR::sendSBLOCK(byte sblock, unsigned int responseOffset)
 {
     data[0] = sblock;
     sendCommand(/*data,*/ 1, false);
-    receiveResponse(0 + 3) ;
+    receiveResponse(0 + 3, responseOffset) ;
 }
 
 //==============================================================================
-void M24SR::writeNdefMessage(NdefMessage* pNDefMsg)
+/** Passes an encoded NDEF message to the NDEF file a write chunk at a time */
+class M24SRNdefSink : public NdefChunkedSink
 {
-    if (pNDefMsg != NULL)
+public:
+    M24SRNdefSink(M24SR& m24sr, uint8_t* buffer, uint8_t size)
+        : NdefChunkedSink(buffer, size), m24sr(m24sr)
+    {
+    }
+protected:
+    boolean writeChunk(unsigned long offset, const byte* data, unsigned int length)
+    {
+        return m24sr.updateBinaryChunk(offset, data, length);
+    }
+private:
+    M24SR& m24sr;
+};
+
+boolean M24SR::writeNdefMessage(NdefMessageBase* pNDefMsg)
+{
+    if (pNDefMsg == NULL)
+    {
+        return false;
+    }
+    if (verbose)
     {
         pNDefMsg->print();
-        NdefRecord rec = pNDefMsg->getRecord(0);
+        const NdefRecord& rec = pNDefMsg->getRecord(0);
         Serial.print(F("NDefRecord: "));
         rec.print();
-        selectFileNdefApp();
-        selectFileNdefFile();
-        updateBinaryNdefMsgLen0();
-        uint8_t len = pNDefMsg->getEncodedSize();
-        uint8_t* mem = (uint8_t*)malloc(len);
-        
-        //TODO memcpy(&data[0], &SAMPLE_NDEF_message1[0], len);
-        //uint8_t encoded[pNDefMsg->getEncodedSize()];
-        pNDefMsg->encode((uint8_t*)mem);
-        
-        updateBinary((char*)mem, len);
-        receiveResponse(2 + 3);
-        free(mem);
-        
-        updateBinaryLen(len);
+    }
+    uint32_t size = pNDefMsg->getEncodedSize();
+    // the NDEF file starts with a 2 byte length
+    if (size > 0xFFFF || (memorySize && size > getMaxNdefSize()))
+    {
+        Serial.print(F("\r\nNDEF message too large: "));
+        Serial.print(size, DEC);
+        Serial.print(F(" > "));
+        Serial.println(getMaxNdefSize(), DEC);
+        return false;
+    }
+    selectFileNdefApp();
+    selectFileNdefFile();
+    updateBinaryNdefMsgLen0();
+
+    uint8_t chunk[M24SR_WRITE_CHUNK];
+    M24SRNdefSink sink(*this, chunk, sizeof(chunk));
+    boolean written = pNDefMsg->encode(sink) == size && sink.flush();
+
+    // the length goes last, so a torn write leaves an empty message
+    if (written)
+    {
+        updateBinaryLen(size);
         receiveResponse(2 + 3);
-        sendDESELECT();
+        written = (err == 0) && responseCrcValid && (response[0] == 0x90) && (response[1] == 0x00);
     }
+    sendDESELECT();
+    return written;
 }
 // //==============================================================================
 void M24SR::selectFileNdefApp()
@@ -200,7 +366,7 @@ void M24SR::selectFileNdefApp()
         Serial.println(F("\r\nselectFile_NDEF_App"));
     }
     sendGetI2cSession = true;
-    sendApdu_P(0x00, INS_SELECT_FILE, 0x04, 0x00, 0x07, AID_NDEF_TAG_APPLICATION2);
+    sendFrame_P(FRAME_SELECT_NDEF_APP[0], sizeof(FRAME_SELECT_NDEF_APP[0]));
     receiveResponse(2 + 3);
 }
 
@@ -210,8 +376,7 @@ void M24SR::selectFileNdefFile()
     {
         Serial.print(F("\r\nselectFile_NDEF_file"));
     }
-    uint8_t ndef_file[] = "\x00\x01";
-    sendApdu(0x00, INS_SELECT_FILE, 0x00, 0x0C, 0x02, ndef_file);
+    sendFrame_P(FRAME_SELECT_NDEF_FILE[0], sizeof(FRAME_SELECT_NDEF_FILE[0]));
     receiveResponse(2 + 3);
 }
 // //==============================================================================
@@ -222,7 +387,7 @@ boolean M24SR::verifyI2cPassword()
         Serial.println(F("\r\nverifyI2cPassword"));
     }
     selectFileNdefApp();
-    sendApdu_P(0x00, INS_VERIFY, 0x00, 0x03, 0x10, DEFAULT_PASSWORD);
+    sendFrame_P(FRAME_VERIFY_DEFAULT_PASSWORD[0], sizeof(FRAME_VERIFY_DEFAULT_PASSWORD[0]));
     receiveResponse(2 + 3);
     return ((response[0] == 0x90) && (response[1] == 0));
 }
@@ -237,6 +402,10 @@ boolean M24SR::checkGPOTrigger()
     lastGPO = newval;
     return false;
 }
+boolean M24SR::isRfSessionOpen()
+{
+    return digitalRead(gpoPin) == LOW;
+}
 //==============================================================================
 void M24SR::updateBinaryLen(int len)
 {
@@ -250,32 +419,20 @@ void M24SR::updateBinaryLen(int len)
     sendApdu(0x00, INS_UPDATE_BINARY, 0x00, 0x00, 0x02, len_bytes);
 }
 //==============================================================================
-void M24SR::updateBinary(char* Data, uint8_t len)
+boolean M24SR::updateBinaryChunk(uint16_t pos, const uint8_t* data, uint8_t len)
 {
     if (verbose)
     {
         Serial.println(F("\r\nupdateBinary"));
-    }
-    dumpHex((uint8_t*)Data, len);
-    uint8_t pos = 0;
-    while(pos < len)
-    {
-        uint8_t chunk_len = (len - pos);
-        if (chunk_len > (BUFFER_LENGTH - 8))
-        {
-            chunk_len = BUFFER_LENGTH - 8;
-        }
+        dumpHex((uint8_t*)data, len);
         Serial.print(F("\r\nchunk_len:"));
-        Serial.print(chunk_len, DEC);
+        Serial.print(len, DEC);
         Serial.print(F(", pos:"));
         Serial.print(pos, DEC);
-        sendApdu(0x00, INS_UPDATE_BINARY, ((pos+2) >> 8) & 0xff, (pos+2) & 0xff, chunk_len, (uint8_t*)&Data[pos]);
-        pos += chunk_len;
-        if (pos < len)
-        {
-            receiveResponse(2 + 3);
-        }
     }
+    sendApdu(0x00, INS_UPDATE_BINARY, ((pos+2) >> 8) & 0xff, (pos+2) & 0xff, len, data);
+    receiveResponse(2 + 3);
+    return (err == 0) && responseCrcValid && (response[0] == 0x90) && (response[1] == 0x00);
 }
 //==============================================================================
 void M24SR::updateBinary(unsigned int offset, char* data, uint8_t len)
@@ -287,10 +444,10 @@ void M24SR::updateBinary(unsigned int offset, char* data, uint8_t len)
     sendApdu(0x00, INS_UPDATE_BINARY, (offset >> 8) & 0xff, (offset & 0xff), len, (uint8_t*)data);
 }
 //==============================================================================
-void M24SR::displaySystemFile()
+uint8_t M24SR::readSystemFile()
 {
     selectFileNdefApp();
-    sendApdu_P(0x00, INS_SELECT_FILE, 0x00, 0x0C, 0x02, FILE_SYSTEM);
+    sendFrame_P(FRAME_SELECT_SYSTEM_FILE[0], sizeof(FRAME_SELECT_SYSTEM_FILE[0]));
     receiveResponse(2 + 3);
     
     sendApdu(0x00, INS_READ_BINARY, 0x00, 0x00, 0x02);
@@ -302,8 +459,71 @@ void M24SR::displaySystemFile()
         Serial.print(response[1] & 0xff, HEX);
     }
     
-    sendApdu(0x00, INS_READ_BINARY, 0x00, 0x00, response[1]);
-    receiveResponse((response[1] & 0xff) + 2 + 3);
+    uint8_t len = response[1];
+    sendApdu(0x00, INS_READ_BINARY, 0x00, 0x00, len);
+    receiveResponse((len & 0xff) + 2 + 3);
+    return len;
+}
+//==============================================================================
+M24SRVariant M24SR::detectVariant()
+{
+    uint8_t len = readSystemFile();
+    if (len <= 0x11)
+    {
+        sendDESELECT();
+        return M24SR_VARIANT_UNKNOWN;
+    }
+    
+    // memory size field is the NDEF file size - 1
+    uint16_t size = (((response[0xf] & 0xff) << 8) | (response[0x10] & 0xff)) + 1;
+    uint8_t code = response[0x11] & ~0x08;
+    sendDESELECT();
+    
+    M24SRVariant detected = M24SR_VARIANT_UNKNOWN;
+    if (code == M24SRTraits<M24SR_VARIANT_02>::productCode)
+        detected = M24SR_VARIANT_02;
+    else if (code == M24SRTraits<M24SR_VARIANT_04>::productCode)
+        detected = M24SR_VARIANT_04;
+    else if (code == M24SRTraits<M24SR_VARIANT_16>::productCode)
+        detected = M24SR_VARIANT_16;
+    else if (code == M24SRTraits<M24SR_VARIANT_64>::productCode)
+        detected = M24SR_VARIANT_64;
+    
+    setVariant(detected, size);
+    if (verbose)
+    {
+        Serial.print(F("\r\nvariant: "));
+        Serial.print(variant, DEC);
+        Serial.print(F(", memory size: "));
+        Serial.print(memorySize, DEC);
+    }
+    return detected;
+}
+
+void M24SR::setVariant(M24SRVariant newVariant, uint16_t newMemorySize)
+{
+    variant = newVariant;
+    memorySize = newMemorySize;
+}
+
+M24SRVariant M24SR::getVariant()
+{
+    return (M24SRVariant)variant;
+}
+
+uint16_t M24SR::getMemorySize()
+{
+    return memorySize;
+}
+
+uint16_t M24SR::getMaxNdefSize()
+{
+    return memorySize > 2 ? memorySize - 2 : 0;
+}
+//==============================================================================
+void M24SR::displaySystemFile()
+{
+    readSystemFile();
     
     //display settings
     Serial.print(F("\r\nUID: "));
@@ -325,36 +545,48 @@ void M24SR::displaySystemFile()
 
 
 //==============================================================================
-void M24SR::sendApdu(uint8_t CLA, uint8_t INS, uint8_t P1, uint8_t P2, uint8_t Lc, uint8_t* Data)
+void M24SR::sendApdu(uint8_t CLA, uint8_t INS, uint8_t P1, uint8_t P2, uint8_t Lc, const uint8_t* Data)
 {
-    data[1] = CLA;
-    data[2] = INS;
-    data[3] = P1;
-    data[4] = P2;
-    data[5] = Lc;
-    memcpy(&data[6], Data, Lc);
-    sendCommand(/*data,*/ 1+5+Lc, true);
+    // header and data go straight to the bus, the CRC is built as they go
+    beginFrame();
+    writeFrameData(nextPcb());
+    writeFrameData(CLA);
+    writeFrameData(INS);
+    writeFrameData(P1);
+    writeFrameData(P2);
+    writeFrameData(Lc);
+    for(uint8_t i = 0; i < Lc; ++i)
+    {
+        writeFrameData(Data[i]);
+    }
+    writeFrameCrc();
+    endFrame();
 }
 
 void M24SR::sendApdu(uint8_t CLA, uint8_t INS, uint8_t P1, uint8_t P2, uint8_t Le)
 {
-    data[1] = CLA;
-    data[2] = INS;
-    data[3] = P1;
-    data[4] = P2;
-    data[5] = Le;
-    sendCommand(/*data, */1+5, true);
+    beginFrame();
+    writeFrameData(nextPcb());
+    writeFrameData(CLA);
+    writeFrameData(INS);
+    writeFrameData(P1);
+    writeFrameData(P2);
+    writeFrameData(Le);
+    writeFrameCrc();
+    endFrame();
 }
 
-void M24SR::sendApdu_P(uint8_t CLA, uint8_t INS, uint8_t P1, uint8_t P2, uint8_t Lc, const char* Data)
+void M24SR::sendFrame_P(const uint8_t* frames, uint8_t len)
 {
-    data[1] = CLA;
-    data[2] = INS;
-    data[3] = P1;
-    data[4] = P2;
-    data[5] = Lc;
-    memcpy_P(&data[6], Data, Lc);
-    sendCommand(/*data,*/ 1+5+Lc, true);
+    const uint8_t* frame = frames + (blockNo * len);
+    blockNo = blockNo ? 0 : 1;
+    
+    beginFrame();
+    for(uint8_t i = 0; i < len; ++i)
+    {
+        writeFrameByte(pgm_read_byte(frame + i));
+    }
+    endFrame();
 }
 
 //==============================================================================
@@ -366,24 +598,40 @@ void M24SR::sendCommand(/*char* data,*/ int len)
 
 void M24SR::sendCommand(/*char* data, */int len, boolean setPCB)
 {
-    uint8_t v;
     if (setPCB)
     {
-        if (blockNo == 0)
-        {
-            data[0] = 0x02;
-            blockNo = 1;
-        } else
-        {
-            data[0] = 0x03;
-            blockNo = 0;
-        }
+        data[0] = nextPcb();
+    }
+    
+    beginFrame();
+    for(int i = 0; i < len; ++i)
+    {
+        writeFrameData(data[i] & 0xff);
+    }
+    writeFrameCrc();
+    endFrame();
+}
+
+uint8_t M24SR::nextPcb()
+{
+    if (blockNo == 0)
+    {
+        blockNo = 1;
+        return 0x02;
     }
+    blockNo = 0;
+    return 0x03;
+}
+
+void M24SR::beginFrame()
+{
     if (sendGetI2cSession)
     {
         Wire.beginTransmission(deviceAddress); // transmit to device 0x2D
         Wire.write(byte(CMD_GETI2CSESSION)); // GetI2Csession
+        unsigned long start = micros();
         err = Wire.endTransmission();     // stop transmitting
+        busMicros += micros() - start;
         if (verbose)
         {
             Serial.print(F("\r\nGetI2Csession: "));
@@ -396,40 +644,29 @@ void M24SR::sendCommand(/*char* data, */int len, boolean setPCB)
     if (cmds)
         Serial.print(F("\r\n=> "));
     else
-        delay(1);
+        pace(1);
     
     Wire.beginTransmission(deviceAddress);
-    
-    for(int i = 0; i < len; ++i)
-    {
-        v = (data[i] & 0xff);
-        if (cmds)
-        {
-            if (v < 0x10)
-            {
-                Serial.print(F("0"));
-            }
-            Serial.print(v, HEX);
-        }
-        else
-        {
-            delay(5);
-        }
-        Wire.write(byte(v & 0xff));
-        if (cmds)
-        {
-            Serial.print(F(" "));
-        }
-        else
-        {
-            delay(1);
-        }
-    }
-    
     //5.5 CRC of the I2C and RF frame ISO/IEC 13239. The initial register content shall be 0x6363
-    int chksum =  crcsum((unsigned char*) data, len, 0x6363 );
-    
-    v = chksum & 0xff;
+    crc16_init(&frameCrc, 0x6363);
+}
+
+void M24SR::writeFrameData(uint8_t v)
+{
+    crc16_update_byte(&frameCrc, v);
+    writeFrameByte(v);
+}
+
+void M24SR::writeFrameCrc()
+{
+    unsigned short chksum = crc16_final(&frameCrc);
+    writeFrameByte(chksum & 0xff);
+    //EOD field
+    writeFrameByte((chksum >> 8) & 0xff);
+}
+
+void M24SR::writeFrameByte(uint8_t v)
+{
     if (cmds)
     {
         if (v < 0x10)
@@ -440,34 +677,31 @@ void M24SR::sendCommand(/*char* data, */int len, boolean setPCB)
     }
     else
     {
-        delay(1);
+        pace(5);
     }
-    
     Wire.write(byte(v & 0xff));
-    
-    //EOD field
-    v = (chksum >> 8) & 0xff;
     if (cmds)
     {
-        if (v < 0x10)
-        {
-            Serial.print(F("0"));
-        }
-        Serial.print(v, HEX);
+        Serial.print(F(" "));
     }
     else
     {
-        delay(1);
+        pace(1);
     }
-    Wire.write(byte(v & 0xff));
-    
+}
+
+void M24SR::endFrame()
+{
+    unsigned long start = micros();
     err = Wire.endTransmission();
+    busMicros += micros() - start;
     if (cmds)
     {
         Serial.print(F("\r\n"));
     }
     else
     {
+        // the M24SR needs a moment before it answers, at any bus speed
         delay(1);
     }
     //TODO does this really work?
@@ -525,10 +759,8 @@ void M24SR::updateBinaryNdefMsgLen0()
 //    sendDESELECT();
 // }
 // //==============================================================================
-NdefMessage* M24SR::getNdefMessage()
+uint16_t M24SR::readNdefFile()
 {
-    unsigned int len = 0;
-    
     selectFileNdefApp();
     selectFileNdefFile();
     //Read NDEF message length 00 B0 00 00 02
@@ -538,39 +770,56 @@ NdefMessage* M24SR::getNdefMessage()
         Serial.print(F("\r\nndef_len: "));
         Serial.println(ndef_len, DEC);
     }
+    if (!(responseCrcValid && (response[2] == 0x90) && (response[3] == 0x00)))
+    {
+        return 0;
+    }
     
-    if (ndef_len < 255)
-        sendApdu(0x00, INS_READ_BINARY, 0x00, 0x02, ndef_len & 0xff);
-    else
+    // The message follows its 2 byte length in the file. Each chunk lands
+    // where the status word and CRC of the one before were, so the message
+    // ends up whole at the start of the response buffer.
+    uint16_t pos = 0;
+    while (pos < ndef_len)
+    {
+        uint8_t len = m24srMin(M24SR_READ_CHUNK, ndef_len - pos);
+        uint16_t offset = pos + 2;
+        sendApdu(0x00, INS_READ_BINARY, (offset >> 8) & 0xff, (offset & 0xff), len);
+        receiveResponse(len + 2 + 3, pos);
+        pos += len;
+        // a reply with a bad CRC or an error status is not part of the message
+        if (!(responseCrcValid && (response[pos] == 0x90) && (response[pos + 1] == 0x00)))
+        {
+            return 0;
+        }
+    }
+    return ndef_len;
+}
+
+NdefMessage* M24SR::getNdefMessage()
+{
+    uint16_t ndef_len = readNdefFile();
+    if (ndef_len == 0)
     {
-        Serial.println(F("TODO: ndef_len > 255"));
+        sendDESELECT();
         return (NdefMessage*)NULL;
     }
-    //uint8_t ndeflen[2];
-    //ndeflen[0] = ndef_len >> 8;
-    //ndeflen[1] = ndef_len & 0xff;
-    //sendApdu(0x00, INS_READ_BINARY, 0x00, 0x00, ndeflen);
-    receiveResponse((response[1] & 0xff) + 2 + 3);
     NdefMessage* pNdefMsg = new NdefMessage((byte *)&response[0], ndef_len);
-    
-    /* TODO
-     NdefRecord rec = pNdefMsg->getRecord(0);
-     
-     String txt = rec.toString();
-     rec.print();
-     tft.fillScreen(ST7735_BLACK);
-     tft.setCursor(0,0);
-     
-     tft.setTextColor(ST7735_WHITE);
-     char szBuf[txt.length()+1];
-     txt.getBytes((unsigned char*)szBuf, txt.length()+1);
-     tft.print(szBuf);
-     */
-    //delete pNdefMsg;
     sendDESELECT();
     return pNdefMsg;
 }
 
+NdefMessageView M24SR::getNdefView()
+{
+    uint16_t ndef_len = readNdefFile();
+    // DESELECT's reply goes after the message so the view stays intact
+    sendDESELECT(ndef_len);
+    if (ndef_len == 0)
+    {
+        return NdefMessageView();
+    }
+    return NdefMessageView(&response[0], ndef_len);
+}
+
 unsigned int M24SR::getNdefMessageLength()
 {
     sendApdu(0x00, INS_READ_BINARY, 0x00, 0x00, 0x02);
@@ -585,6 +834,20 @@ void M24SR::print()
 {
     Serial.print(F("\nM24SR GPO:"));
     Serial.println(gpoPin);
+    Serial.print(F("I2C: "));
+    Serial.print(busSpeed / 1000, DEC);
+    Serial.println(F(" kHz"));
+    for (uint8_t i = 0; i < M24SR_I2C_SPEED_COUNT; ++i)
+    {
+        if (busThroughput[i])
+        {
+            Serial.print(F("  "));
+            Serial.print(busSpeeds[i] / 1000, DEC);
+            Serial.print(F(" kHz: "));
+            Serial.print(busThroughput[i], DEC);
+            Serial.println(F(" B/s"));
+        }
+    }
 }
 //==============================================================================
 void M24SR::dumpHex(uint8_t* buffer, uint8_t len)
@@ -607,7 +870,7 @@ void M24SR::displayNDefRecord()
     if (pNDefMsg != NULL)
     {
         pNDefMsg->print();
-        NdefRecord rec = pNDefMsg->getRecord(0);
+        const NdefRecord& rec = pNDefMsg->getRecord(0);
         Serial.print(F("NDefRecord: "));
         rec.print();
         delete pNDefMsg;
@@ -28,7 +28,7 @@
  - test: > 1 NDef record in NDef message
  - read/write data (without NDef classes)
  - what to do with writeSampleMsg?
- - ndef_len > 255
+ - reading ndef_len > 255
  - password handling
  - dynamic data buffer
  - if (len > BUFFER_LENGTH - 8) update for-loop
@@ -57,13 +57,104 @@
 // Additional Libraries
 
 #include <NfcAdapter.h> // from NDEF library (include NDefMessage)
+#include <NdefView.h>
+#include <NdefSink.h>
 #include <crc16.h>
+#include <CrcEngine.h>
 // #include <PN532.h> //
+//==============================================================================
+// I2C bus speeds supported by the M24SR
+
+#define M24SR_I2C_STANDARD_MODE  100000UL
+#define M24SR_I2C_FAST_MODE      400000UL
+#define M24SR_I2C_FAST_MODE_PLUS 1000000UL
+#define M24SR_I2C_SPEED_COUNT    3
+
+//==============================================================================
+// M24SR variants
+//
+// Identified from the product code in the system file (offset 0x11). The -G parts
+// differ from the -Y parts only in bit 3 of the product code.
+
+enum M24SRVariant
+{
+    M24SR_VARIANT_UNKNOWN = 0,
+    M24SR_VARIANT_02,
+    M24SR_VARIANT_04,
+    M24SR_VARIANT_16,
+    M24SR_VARIANT_64
+};
+
+/** Largest data field for one READ_BINARY / UPDATE_BINARY (datasheet 0xF6) */
+#define M24SR_MAX_APDU_DATA 0xF6
+/** The Wire buffer also holds PCB, CLA, INS, P1, P2, Lc and the CRC */
+#define M24SR_WIRE_WRITE_CHUNK (BUFFER_LENGTH - 8)
+
+constexpr uint16_t m24srMin(uint16_t a, uint16_t b)
+{
+    return a < b ? a : b;
+}
+
+/** Bytes per UPDATE_BINARY. The Wire buffer is far smaller than the
+    smallest part, so this is the same for every variant. */
+#define M24SR_WRITE_CHUNK m24srMin(M24SR_MAX_APDU_DATA, M24SR_WIRE_WRITE_CHUNK)
+/** The Wire buffer also holds PCB, SW1, SW2 and the CRC of a reply */
+#define M24SR_WIRE_READ_CHUNK (BUFFER_LENGTH - 5)
+/** Bytes per READ_BINARY when reading the NDEF message */
+#define M24SR_READ_CHUNK m24srMin(M24SR_MAX_APDU_DATA, M24SR_WIRE_READ_CHUNK)
+
+/** Product code and sizes of an M24SR part, for detectVariant and M24SRDevice.
+    memorySize is the NDEF file size, the first two bytes of which hold the NDEF length. */
+template <uint8_t variant>
+struct M24SRTraits;
+
+#define M24SR_TRAITS(VARIANT, PRODUCT_CODE, MEMORY_SIZE) \
+template <> \
+struct M24SRTraits<VARIANT> \
+{ \
+    static constexpr uint8_t productCode = PRODUCT_CODE; \
+    static constexpr uint16_t memorySize = MEMORY_SIZE; \
+    static constexpr uint16_t maxNdefSize = MEMORY_SIZE - 2; \
+};
+
+M24SR_TRAITS(M24SR_VARIANT_02, 0x82, 256)
+M24SR_TRAITS(M24SR_VARIANT_04, 0x86, 512)
+M24SR_TRAITS(M24SR_VARIANT_16, 0x85, 2048)
+M24SR_TRAITS(M24SR_VARIANT_64, 0x84, 8192)
+
+#undef M24SR_TRAITS
+
+//==============================================================================
+// Compile-time CRC
+//
+// 5.5 CRC of the I2C and RF frame ISO/IEC 13239. The initial register content shall be 0x6363
+// CrcIso14443A::compute folds a list of constant bytes into its CRC at compile time,
+// so that constant frames can carry their CRC from flash.
+
+/** A complete I2C frame: PCB, APDU and the two CRC bytes (LSB first) */
+#define M24SR_FRAME(PCB, ...) { PCB, __VA_ARGS__, \
+    (uint8_t)(CrcIso14443A::compute(PCB, __VA_ARGS__) & 0xff), \
+    (uint8_t)((CrcIso14443A::compute(PCB, __VA_ARGS__) >> 8) & 0xff) }
+
+/** The same frame for both I-Block numbers, PCB 0x02 and 0x03 */
+#define M24SR_FRAME_PAIR(...) { M24SR_FRAME(0x02, __VA_ARGS__), M24SR_FRAME(0x03, __VA_ARGS__) }
+
 //==============================================================================
 // Program Memory constants
-const char FILE_SYSTEM[] PROGMEM = "\xE1\x01";
-const char AID_NDEF_TAG_APPLICATION2[] PROGMEM = "\xD2\x76\x00\x00\x85\x01\x01";
-const char DEFAULT_PASSWORD[] PROGMEM = "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+//
+// Commands that never change are kept as complete frames, indexed by blockNo.
+// They are written straight to the bus by sendFrame_P, no copy into data and no crcsum.
+
+#define APDU_SELECT_NDEF_APP 0x00, 0xA4, 0x04, 0x00, 0x07, 0xD2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x01
+#define APDU_SELECT_SYSTEM_FILE 0x00, 0xA4, 0x00, 0x0C, 0x02, 0xE1, 0x01
+#define APDU_SELECT_NDEF_FILE 0x00, 0xA4, 0x00, 0x0C, 0x02, 0x00, 0x01
+#define APDU_VERIFY_DEFAULT_PASSWORD 0x00, 0x20, 0x00, 0x03, 0x10, \
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+
+const uint8_t FRAME_SELECT_NDEF_APP[2][1 + 12 + 2] PROGMEM = M24SR_FRAME_PAIR(APDU_SELECT_NDEF_APP);
+const uint8_t FRAME_SELECT_SYSTEM_FILE[2][1 + 7 + 2] PROGMEM = M24SR_FRAME_PAIR(APDU_SELECT_SYSTEM_FILE);
+const uint8_t FRAME_SELECT_NDEF_FILE[2][1 + 7 + 2] PROGMEM = M24SR_FRAME_PAIR(APDU_SELECT_NDEF_FILE);
+const uint8_t FRAME_VERIFY_DEFAULT_PASSWORD[2][1 + 21 + 2] PROGMEM = M24SR_FRAME_PAIR(APDU_VERIFY_DEFAULT_PASSWORD);
 
 //==============================================================================
 // UNUSED CONSTANTS
@@ -89,10 +180,7 @@ const char DEFAULT_PASSWORD[] PROGMEM = "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x0
 // // EMPTY Tag
 // // 00 03    D0 00 00
 //==============================================================================
-// //const char SELECT_NDEF_Tag_Application2[] PROGMEM = "\x00\xA4\x04\x00\x07\xD2\x76\x00\x00\x85\x01\x01";
 // //const char SELECT_CC[] PROGMEM = "\x00\xA4\x00\x0C\x02\xE1\x03";
-// //const char SELECT_NDEF_file[] PROGMEM = "\x00\xA4\x00\x0C\x02\x00\x01";
-// //const char SELECT_system_file[] PROGMEM = "\x00\xA4\x00\x0C\x02\xE1\x01";
 // //const char UPDATE_BINARY_NDEF_MSG_LEN0[] PROGMEM = "\x00\xD6\x00\x00\x02\x00\x00";
 // //const char READ_BINARY_LENGTH[] PROGMEM = "\x02\x00\xB0\x00\x00\x02";
 // //const char READ_BINARY[] PROGMEM = "\x02\x00\xB0\x00\x00";
@@ -102,6 +190,7 @@ const char DEFAULT_PASSWORD[] PROGMEM = "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x0
 /** Class to interface with the ST M24SR chip used in NFC Tags. */
 class M24SR
 {
+    friend class M24SRNdefSink;
 public:
     //==========================================================================
     M24SR(uint8_t gpoArduinoPin);
@@ -117,35 +206,86 @@ public:
     void displayNDefRecord();
     //==========================================================================
     /** Initialise the class, run in Setup() after Serial has been initialised.
-        This is likely not the best way to achieve this. */
-    void setup();
+        This is likely not the best way to achieve this.
+
+        busSpeed is the fastest I2C clock to try (Hz). Each speed from there down
+        to 100 kHz is probed with a SELECT and the first that answers is kept.
+        The default stays at 100 kHz; pass M24SR_I2C_FAST_MODE or faster to opt in.
+        @return the bus speed in use, 0 if the M24SR did not answer at any speed */
+    uint32_t setup(uint32_t busSpeed = M24SR_I2C_STANDARD_MODE);
+    /** I2C clock chosen by setup() */
+    uint32_t getBusSpeed();
+    /** Throughput measured while probing a bus speed, in bytes per second.
+        Only the time spent in Wire transfers counts, not the pacing delays.
+        0 if that speed was not probed or the M24SR did not answer. */
+    unsigned long getBusThroughput(uint32_t busSpeed);
     //==========================================================================
     boolean checkGPOTrigger();
+    /** True while the GPO pin is low. setup() writes 0x61 to the GPO byte:
+        RF_GPO 110 "RF busy" and I2C_GPO 001 "session opened", so the pin
+        is low while a reader is busy and also during the driver's own I2C
+        sessions. It only means an RF session between I2C sessions, i.e.
+        outside calls into this class, which always end with DESELECT. */
+    boolean isRfSessionOpen();
     unsigned int getNdefMessageLength();
     boolean verifyI2cPassword();
     void checkCRC(char* data, int len);
     void selfTest();
     void writeSampleMsg(uint8_t msgNo);
     void displaySystemFile();
+    /** Read the system file and work out which M24SR this is.
+        Called by setup() unless the variant was given up front with M24SRDevice. */
+    M24SRVariant detectVariant();
+    M24SRVariant getVariant();
+    /** NDEF file size in bytes, 0 if unknown */
+    uint16_t getMemorySize();
+    /** Largest NDEF message that fits, 0 if unknown */
+    uint16_t getMaxNdefSize();
     void dumpHex(uint8_t* buffer, uint8_t len);
     int receiveResponse(unsigned int len);
+    /** True if the last response ended in a valid CRC */
+    boolean isResponseCrcValid();
     //==========================================================================
     void getUID();
     NdefMessage* getNdefMessage();
-    void writeNdefMessage(NdefMessage* message);
+    /** Read the NDEF message without copying it. The view points into the receive
+        buffer and is only valid until the next call that talks to the M24SR.
+        The view is empty if the message could not be read, or if any reply
+        had a bad CRC or a status other than 90 00. */
+    NdefMessageView getNdefView();
+    /** The message is encoded straight into write chunks, so it never needs
+        a buffer of its full size.
+        @return true if the M24SR acknowledged every chunk and the final length update */
+    boolean writeNdefMessage(NdefMessageBase* message);
 
     //TODO boolean verifyI2cPassword(uint8_t* pwd);
     //TODO boolean setI2cPassword(uint8_t* old_password, uint8_t* new_password);
+protected:
+  /** Fix the variant without reading the system file */
+  void setVariant(M24SRVariant variant, uint16_t memorySize);
 private:
   //==========================================================================
   // Private methods
 
+  /** Read the whole system file into response. Returns its length */
+  uint8_t readSystemFile();
+
   /** Write to the General Purpose Output */
   void writeGPO(uint8_t data);
+  /** Try a SELECT at busSpeed, recording the throughput. Returns true on 90 00 */
+  boolean probeBusSpeed(uint8_t speedIndex);
+  /** delay() between bytes and frames, only at Standard mode */
+  void pace(unsigned long ms);
 
-  void sendDESELECT();
-  void sendSBLOCK(uint8_t sblock);
-  void updateBinary(char* data, uint8_t len);
+  /** responseOffset: where in response to put the reply, to keep earlier data intact */
+  void sendDESELECT(unsigned int responseOffset = 0);
+  void sendSBLOCK(uint8_t sblock, unsigned int responseOffset = 0);
+  int receiveResponse(unsigned int len, unsigned int responseOffset);
+  /** Select and read the NDEF file into response. Returns the NDEF length, 0 on failure */
+  uint16_t readNdefFile();
+  /** Write len bytes pos bytes into the NDEF message, past the length field.
+      @return true on 90 00 */
+  boolean updateBinaryChunk(uint16_t pos, const uint8_t* data, uint8_t len);
   void updateBinary(unsigned int offset, char* data, uint8_t len);
   void updateBinaryLen(int len);
   void updateBinaryNdefMsgLen0();
@@ -153,10 +293,22 @@ private:
   void selectFileNdefApp();
   void sendCommand(/*char* data,*/ int len);
   void sendCommand(/*char* data,*/ int len, boolean setPCB);
+  /** Send one of the precomputed FRAME_* pairs from program memory.
+      frames points at the pair, len is the size of a single frame. */
+  void sendFrame_P(const uint8_t* frames, uint8_t len);
+  /** Open the I2C session if needed and start a transmission */
+  void beginFrame();
+  void writeFrameByte(uint8_t value);
+  /** Write a byte and add it to the frame CRC */
+  void writeFrameData(uint8_t value);
+  /** Write the frame CRC, LSB first */
+  void writeFrameCrc();
+  void endFrame();
+  /** PCB for the next I-Block, alternating the block number */
+  uint8_t nextPcb();
   /** Application Protocol Data Unit */
-  void sendApdu(uint8_t CLA, uint8_t INS, uint8_t P1, uint8_t P2, uint8_t Lc, uint8_t* Data);
+  void sendApdu(uint8_t CLA, uint8_t INS, uint8_t P1, uint8_t P2, uint8_t Lc, const uint8_t* Data);
   void sendApdu(uint8_t CLA, uint8_t INS, uint8_t P1, uint8_t P2, uint8_t Le);
-  void sendApdu_P(uint8_t CLA, uint8_t INS, uint8_t P1, uint8_t P2, uint8_t Lc, const char* Data);
 private:
     //==========================================================================
     uint8_t gpoPin;
@@ -165,8 +317,20 @@ private:
     boolean sendGetI2cSession;
     uint8_t err;
     uint8_t blockNo;
-    uint8_t responseLength;
+    /** Size of response. Replies of up to 0xF6 bytes plus framing, placed
+        after an earlier message, do not fit in 8 bits. */
+    unsigned int responseLength;
     uint8_t* response;
+    boolean responseCrcValid;
+    crc16_ctx frameCrc;
+    uint32_t busSpeed;
+    /** The per-byte delays are kept at 100 kHz, where the driver always had them */
+    boolean paced;
+    /** Time spent in Wire transfers, for the probe */
+    unsigned long busMicros;
+    uint8_t variant;
+    uint16_t memorySize;
+    unsigned long busThroughput[M24SR_I2C_SPEED_COUNT];
     //==========================================================================
     // Class constants
     const char CMD_GETI2CSESSION = 0x26;
@@ -183,4 +347,25 @@ public:
     char data[100]; //TODO dynamic buffer
 };
 
+//==============================================================================
+/** M24SR whose variant is known in advance, e.g. M24SR64 m24sr(gpo_pin);
+    The memory size comes from M24SRTraits, so setup() skips reading the system file.
+    Code and RAM are the same as for M24SR. */
+template <uint8_t deviceVariant>
+class M24SRDevice : public M24SR
+{
+public:
+    typedef M24SRTraits<deviceVariant> Traits;
+
+    M24SRDevice(uint8_t gpoArduinoPin) : M24SR(gpoArduinoPin)
+    {
+        setVariant((M24SRVariant)deviceVariant, Traits::memorySize);
+    }
+};
+
+typedef M24SRDevice<M24SR_VARIANT_02> M24SR02;
+typedef M24SRDevice<M24SR_VARIANT_04> M24SR04;
+typedef M24SRDevice<M24SR_VARIANT_16> M24SR16;
+typedef M24SRDevice<M24SR_VARIANT_64> M24SR64;
+
 #endif
@@ -0,0 +1,115 @@
+/* Deferred, coalescing NDEF writes for the M24SR
+ */
+//==============================================================================
+#include <M24SRWriteQueue.h>
+//==============================================================================
+M24SRWriteQueue::M24SRWriteQueue(M24SR& device) : m24sr(device)
+{
+    depth = 0;
+    queuedAt = 0;
+    supersededCount = 0;
+    flushCount = 0;
+    lastFlushLatency = 0;
+    maxFlushLatency = 0;
+}
+//==============================================================================
+void M24SRWriteQueue::write(const NdefMessageBase& message)
+{
+    NdefMessage copy = message;
+    write(static_cast<NdefMessageBase&&>(copy));
+}
+
+void M24SRWriteQueue::write(NdefMessageBase&& message)
+{
+    if (depth == 0)
+    {
+        queuedAt = millis();
+    }
+    else
+    {
+        supersededCount++;
+    }
+    
+    pending = static_cast<NdefMessageBase&&>(message);
+    if (depth < 0xFF)
+    {
+        depth++;
+    }
+}
+//==============================================================================
+boolean M24SRWriteQueue::update()
+{
+    if (depth == 0 || m24sr.isRfSessionOpen())
+    {
+        return false;
+    }
+    
+    if (!m24sr.writeNdefMessage(&pending))
+    {
+        // keep it and try again at the next free window
+        return false;
+    }
+    
+    lastFlushLatency = millis() - queuedAt;
+    if (lastFlushLatency > maxFlushLatency)
+    {
+        maxFlushLatency = lastFlushLatency;
+    }
+    flushCount++;
+    clear();
+    return true;
+}
+//==============================================================================
+void M24SRWriteQueue::clear()
+{
+    pending = NdefMessage();
+    depth = 0;
+}
+
+boolean M24SRWriteQueue::isPending()
+{
+    return depth != 0;
+}
+//==============================================================================
+uint8_t M24SRWriteQueue::getDepth()
+{
+    return depth;
+}
+
+unsigned long M24SRWriteQueue::getSupersededCount()
+{
+    return supersededCount;
+}
+
+unsigned long M24SRWriteQueue::getFlushCount()
+{
+    return flushCount;
+}
+
+unsigned long M24SRWriteQueue::getLastFlushLatency()
+{
+    return lastFlushLatency;
+}
+
+unsigned long M24SRWriteQueue::getMaxFlushLatency()
+{
+    return maxFlushLatency;
+}
+//==============================================================================
+void M24SRWriteQueue::print()
+{
+    Serial.print(F("\r\nWrite queue depth: "));
+    Serial.print(depth, DEC);
+    Serial.print(F(", superseded: "));
+    Serial.print(supersededCount, DEC);
+    Serial.print(F(", flushed: "));
+    Serial.print(flushCount, DEC);
+    Serial.print(F(", latency: "));
+    Serial.print(lastFlushLatency, DEC);
+    Serial.print(F(" ms (max "));
+    Serial.print(maxFlushLatency, DEC);
+    Serial.println(F(" ms)"));
+}
+
+//==============================================================================
+//EOF
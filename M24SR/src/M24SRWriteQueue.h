@@ -0,0 +1,66 @@
+/* Deferred, coalescing NDEF writes for the M24SR
+
+  While a phone holds the RF session the M24SR will not grant an I2C session, so
+  writing every time new content is produced either fails or blocks. The queue keeps
+  only the newest message and writes it once the GPO reports the RF side is idle.
+
+  Usage:
+
+     M24SRWriteQueue queue(m24sr);
+     queue.write(message);   // as often as you like
+     ...
+     void loop()
+     {
+         queue.update();     // writes the newest message at the first free I2C window
+     }
+ */
+//==============================================================================
+#ifndef M24SRWriteQueue_h
+#define M24SRWriteQueue_h
+//==============================================================================
+#include <M24SR.h>
+//==============================================================================
+
+class M24SRWriteQueue
+{
+public:
+    //==========================================================================
+    M24SRWriteQueue(M24SR& m24sr);
+    //==========================================================================
+    /** Queue a message. Anything queued and not yet written is dropped. */
+    void write(const NdefMessageBase& message);
+    /** Queue a message without copying it; message is left empty */
+    void write(NdefMessageBase&& message);
+    /** Run from loop(). Writes the pending message if the RF side is idle.
+        @return true if a message was written */
+    boolean update();
+    /** Drop the pending message without writing it */
+    void clear();
+    boolean isPending();
+    //==========================================================================
+    // Metrics
+
+    /** Number of writes folded into the pending message, 0 if nothing is pending */
+    uint8_t getDepth();
+    /** Writes replaced by newer content before reaching the tag */
+    unsigned long getSupersededCount();
+    /** Messages written to the tag */
+    unsigned long getFlushCount();
+    /** ms from the first queued write to the tag being updated, for the last flush */
+    unsigned long getLastFlushLatency();
+    unsigned long getMaxFlushLatency();
+    /** Print the metrics to Serial */
+    void print();
+private:
+    //==========================================================================
+    M24SR& m24sr;
+    NdefMessage pending;
+    uint8_t depth;
+    unsigned long queuedAt;
+    unsigned long supersededCount;
+    unsigned long flushCount;
+    unsigned long lastFlushLatency;
+    unsigned long maxFlushLatency;
+};
+
+#endif
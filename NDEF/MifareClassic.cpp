@@ -325,7 +325,7 @@ boolean MifareClassic::formatMifare(byte * uid, unsigned int uidLength)
     return true;
 }
 
-boolean MifareClassic::write(NdefMessage& m, byte * uid, unsigned int uidLength)
+boolean MifareClassic::write(NdefMessageBase& m, byte * uid, unsigned int uidLength)
 {
 
     uint8_t encoded[m.getEncodedSize()];
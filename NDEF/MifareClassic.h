@@ -12,7 +12,7 @@ class MifareClassic
         MifareClassic(PN532& nfcShield);
         ~MifareClassic();
         NfcTag read(byte *uid, unsigned int uidLength);
-        boolean write(NdefMessage& ndefMessage, byte *uid, unsigned int uidLength);
+        boolean write(NdefMessageBase& ndefMessage, byte *uid, unsigned int uidLength);
         boolean formatNDEF(byte * uid, unsigned int uidLength);
         boolean formatMifare(byte * uid, unsigned int uidLength);
     private:
@@ -36,7 +36,7 @@ NfcTag MifareUltralight::read(byte * uid, unsigned int uidLength)
     if (messageLength == 0) { // data is 0x44 0x03 0x00 0xFE
         NdefMessage message = NdefMessage();
         message.addEmptyRecord();
-        return NfcTag(uid, uidLength, NFC_FORUM_TAG_TYPE_2, message);
+        return NfcTag(uid, uidLength, NFC_FORUM_TAG_TYPE_2, static_cast<NdefMessage&&>(message));
     }
 
     boolean success;
@@ -70,8 +70,8 @@ NfcTag MifareUltralight::read(byte * uid, unsigned int uidLength)
         index += ULTRALIGHT_PAGE_SIZE;
     }
 
-    NdefMessage ndefMessage = NdefMessage(&buffer[ndefStartIndex], messageLength);
-    return NfcTag(uid, uidLength, NFC_FORUM_TAG_TYPE_2, ndefMessage);
+    // decode straight into the tag
+    return NfcTag(uid, uidLength, NFC_FORUM_TAG_TYPE_2, &buffer[ndefStartIndex], messageLength);
 
 }
 
@@ -162,7 +162,7 @@ void MifareUltralight::calculateBufferSize()
     }
 }
 
-boolean MifareUltralight::write(NdefMessage& m, byte * uid, unsigned int uidLength)
+boolean MifareUltralight::write(NdefMessageBase& m, byte * uid, unsigned int uidLength)
 {
     if (isUnformatted())
     {
@@ -11,7 +11,7 @@ class MifareUltralight
         MifareUltralight(PN532& nfcShield);
         ~MifareUltralight();
         NfcTag read(byte *uid, unsigned int uidLength);
-        boolean write(NdefMessage& ndefMessage, byte *uid, unsigned int uidLength);
+        boolean write(NdefMessageBase& ndefMessage, byte *uid, unsigned int uidLength);
         boolean clean();
     private:
         PN532* nfc;
@@ -1,5 +1,37 @@
 #include "Ndef.h"
 
+const __FlashStringHelper *NdefStatusString(NdefStatus status)
+{
+  switch (status)
+  {
+    case NDEF_OK: return F("OK");
+    case NDEF_ERROR_EMPTY: return F("Empty message");
+    case NDEF_ERROR_TRUNCATED: return F("Truncated record");
+    case NDEF_ERROR_MESSAGE_BEGIN: return F("Bad message begin flag");
+    case NDEF_ERROR_MESSAGE_END: return F("No message end flag");
+    case NDEF_ERROR_TNF: return F("Bad TNF");
+    case NDEF_ERROR_CHUNK: return F("Bad chunk sequence");
+    case NDEF_ERROR_NO_MEMORY: return F("Out of memory");
+    case NDEF_ERROR_COMPRESSION: return F("Bad compressed record");
+  }
+  return F("Unknown error");
+}
+
+bool NdefSpan::isEmpty() const
+{
+  return length == 0;
+}
+
+bool NdefSpan::equals(const byte *bytes, unsigned int numBytes) const
+{
+  return length == numBytes && (length == 0 || memcmp(data, bytes, length) == 0);
+}
+
+bool NdefSpan::equals(const char *text) const
+{
+  return equals((const byte *)text, strlen(text));
+}
+
 // Borrowed from Adafruit_NFCShield_I2C
 void PrintHex(const byte * data, const long numBytes)
 {
@@ -11,6 +11,34 @@
   #define NULL (void *)0
 #endif
 
+// result of decoding an encoded NDEF message
+enum NdefStatus
+{
+    NDEF_OK = 0,
+    NDEF_ERROR_EMPTY,           // no bytes to decode
+    NDEF_ERROR_TRUNCATED,       // a header or field runs past the end of the buffer
+    NDEF_ERROR_MESSAGE_BEGIN,   // MB missing on the first record or set on a later one
+    NDEF_ERROR_MESSAGE_END,     // the buffer ends before a record with ME
+    NDEF_ERROR_TNF,             // reserved TNF, or lengths the TNF does not allow
+    NDEF_ERROR_CHUNK,           // chunked record out of sequence
+    NDEF_ERROR_NO_MEMORY,       // no room for the decoded records
+    NDEF_ERROR_COMPRESSION      // a compressed record that does not decompress
+};
+
+const __FlashStringHelper *NdefStatusString(NdefStatus status);
+
+// a run of bytes in someone else's buffer
+struct NdefSpan
+{
+    const byte *data;
+    unsigned int length;
+
+    bool isEmpty() const;
+    bool equals(const byte *bytes, unsigned int numBytes) const;
+    // compare with a NUL terminated string such as a record type
+    bool equals(const char *text) const;
+};
+
 void PrintHex(const byte *data, const long numBytes);
 void PrintHexChar(const byte *data, const long numBytes);
 void DumpHex(const byte *data, const long numBytes, const int blockSize);
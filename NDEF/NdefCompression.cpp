@@ -0,0 +1,349 @@
+#include <NdefCompression.h>
+
+// The compressed stream is a run of tokens. A token below 0x80 is followed
+// by token + 1 literal bytes. Any other is a match of bits 6..3 + 3 bytes,
+// from a distance back whose top 3 bits are bits 2..0 and low 8 bits the
+// next byte. A length of 15 + 3 takes one more byte to add to it.
+#define LZ_MAX_LITERALS 128
+#define LZ_MIN_MATCH 3
+#define LZ_LONG_MATCH (15 + LZ_MIN_MATCH)
+#define LZ_MAX_MATCH (LZ_LONG_MATCH + 0xFF)
+#define LZ_MAX_OFFSET 0x7FF
+// the most a byte of stream expands to, a long match taking 3 bytes
+#define LZ_MAX_EXPANSION (LZ_MAX_MATCH / 3)
+
+unsigned int NdefCompressedHeaderSize(unsigned int typeLength)
+{
+    return 3 + typeLength + 4;
+}
+
+bool NdefIsCompressed(byte tnf, NdefSpan type)
+{
+    return tnf == TNF_EXTERNAL_TYPE && type.equals(NDEF_COMPRESSED_TYPE);
+}
+
+static unsigned int lzHash(const byte *data)
+{
+    uint16_t hash = (data[0] << 8) ^ (data[1] << 4) ^ data[2];
+    return (uint16_t)(hash * 40503U) >> (16 - NDEF_LZ_HASH_BITS);
+}
+
+// write the literals in runs of at most 128; false if out is full
+static bool lzLiterals(const byte *data, uint32_t count, byte *out, uint32_t outSize, uint32_t& o)
+{
+    while (count)
+    {
+        uint32_t run = count < LZ_MAX_LITERALS ? count : LZ_MAX_LITERALS;
+        if (outSize - o < 1 + run)
+        {
+            return false;
+        }
+        out[o++] = run - 1;
+        memcpy(&out[o], data, run);
+        o += run;
+        data += run;
+        count -= run;
+    }
+    return true;
+}
+
+// Greedy, one candidate per hash: fast and small enough for an Uno, at
+// the cost of some ratio against a full LZ search.
+uint32_t NdefLzCompress(const byte *data, uint32_t length, byte *out, uint32_t outSize)
+{
+    // positions modulo 64k, a stale one only costs a failed compare
+    uint16_t table[1 << NDEF_LZ_HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    uint32_t o = 0;
+    uint32_t literals = 0;
+    uint32_t i = 0;
+
+    while (i + LZ_MIN_MATCH <= length)
+    {
+        unsigned int h = lzHash(&data[i]);
+        uint16_t distance = (uint16_t)i - table[h];
+        table[h] = (uint16_t)i;
+
+        if (distance == 0 || distance > i || distance > LZ_MAX_OFFSET ||
+            memcmp(&data[i - distance], &data[i], LZ_MIN_MATCH) != 0)
+        {
+            i++;
+            continue;
+        }
+
+        uint32_t match = LZ_MIN_MATCH;
+        while (i + match < length && match < LZ_MAX_MATCH &&
+               data[i + match - distance] == data[i + match])
+        {
+            match++;
+        }
+
+        if (!lzLiterals(&data[literals], i - literals, out, outSize, o) ||
+            outSize - o < 3)
+        {
+            return 0;
+        }
+        byte lengthCode = match < LZ_LONG_MATCH ? match - LZ_MIN_MATCH : 15;
+        out[o++] = 0x80 | (lengthCode << 3) | (distance >> 8);
+        out[o++] = distance & 0xFF;
+        if (lengthCode == 15)
+        {
+            out[o++] = match - LZ_LONG_MATCH;
+        }
+
+        // remember where the matched bytes start too, repeats in JSON
+        // and text tend to overlap
+        uint32_t end = i + match;
+        for (i++; i < end && i + LZ_MIN_MATCH <= length; i++)
+        {
+            table[lzHash(&data[i])] = (uint16_t)i;
+        }
+        i = end;
+        literals = i;
+    }
+
+    if (!lzLiterals(&data[literals], length - literals, out, outSize, o))
+    {
+        return 0;
+    }
+    return o;
+}
+
+uint32_t NdefDecompressedSize(NdefSpan payload)
+{
+    if (payload.length < 3 || payload.data[0] != NDEF_LZ_FORMAT)
+    {
+        return 0;
+    }
+
+    unsigned int typeLength = payload.data[2];
+    unsigned int headerSize = NdefCompressedHeaderSize(typeLength);
+    if (payload.length < headerSize)
+    {
+        return 0;
+    }
+
+    const byte *length = &payload.data[headerSize - 4];
+    uint32_t payloadLength = ((uint32_t)length[0] << 24) | ((uint32_t)length[1] << 16) |
+                             ((uint32_t)length[2] << 8) | length[3];
+    if (payloadLength > 0xFFFFFFFFUL - typeLength)
+    {
+        return 0;
+    }
+    // more than the stream after the header could expand to, so nobody
+    // sizes a buffer by a length the record cannot back up
+    if (payloadLength / LZ_MAX_EXPANSION > payload.length - headerSize)
+    {
+        return 0;
+    }
+    return typeLength + payloadLength;
+}
+
+NdefDecompressor::NdefDecompressor(byte *out, uint32_t outSize)
+{
+    _out = out;
+    _outSize = outSize;
+    reset();
+}
+
+void NdefDecompressor::reset()
+{
+    _state = STATE_FORMAT;
+    _status = NDEF_OK;
+    _tnf = TNF_EMPTY;
+    _typeLength = 0;
+    _payloadLength = 0;
+    _written = 0;
+    _remaining = 0;
+    _matchLength = 0;
+    _offset = 0;
+}
+
+NdefStatus NdefDecompressor::write(const byte *data, unsigned int numBytes)
+{
+    while (numBytes && _state < STATE_DONE)
+    {
+        unsigned int count = 1;
+        byte b = data[0];
+
+        switch (_state)
+        {
+            case STATE_FORMAT:
+                if (b != NDEF_LZ_FORMAT)
+                {
+                    return fail(NDEF_ERROR_COMPRESSION);
+                }
+                _state = STATE_TNF;
+                break;
+
+            case STATE_TNF:
+                _tnf = b;
+                _state = STATE_TYPE_LENGTH;
+                break;
+
+            case STATE_TYPE_LENGTH:
+                _typeLength = b;
+                if (_typeLength > _outSize)
+                {
+                    return fail(NDEF_ERROR_NO_MEMORY);
+                }
+                _remaining = _typeLength ? _typeLength : 4;
+                _state = _typeLength ? STATE_TYPE : STATE_LENGTH;
+                break;
+
+            case STATE_TYPE:
+                count = _remaining < numBytes ? _remaining : numBytes;
+                memcpy(&_out[_written], data, count);
+                _written += count;
+                _remaining -= count;
+                if (_remaining == 0)
+                {
+                    _remaining = 4;
+                    _state = STATE_LENGTH;
+                }
+                break;
+
+            case STATE_LENGTH:
+                _payloadLength = (_payloadLength << 8) | b;
+                if (--_remaining == 0)
+                {
+                    startPayload();
+                }
+                break;
+
+            case STATE_TOKEN:
+                if (b < 0x80)
+                {
+                    _remaining = b + 1;
+                    if (_written + _remaining > _typeLength + _payloadLength)
+                    {
+                        return fail(NDEF_ERROR_COMPRESSION);
+                    }
+                    _state = STATE_LITERAL;
+                }
+                else
+                {
+                    _matchLength = ((b >> 3) & 0xF) + LZ_MIN_MATCH;
+                    _offset = (b & 0x7) << 8;
+                    _state = STATE_OFFSET;
+                }
+                break;
+
+            case STATE_LITERAL:
+                count = _remaining < numBytes ? _remaining : numBytes;
+                memcpy(&_out[_written], data, count);
+                _written += count;
+                _remaining -= count;
+                if (_remaining == 0)
+                {
+                    endToken();
+                }
+                break;
+
+            case STATE_OFFSET:
+                _offset |= b;
+                if (_matchLength == LZ_LONG_MATCH)
+                {
+                    _state = STATE_MATCH_EXTRA;
+                }
+                else
+                {
+                    copyMatch();
+                }
+                break;
+
+            case STATE_MATCH_EXTRA:
+                _matchLength += b;
+                copyMatch();
+                break;
+
+            default:
+                break;
+        }
+
+        data += count;
+        numBytes -= count;
+    }
+
+    // bytes past the end of the stream
+    if (numBytes && _state == STATE_DONE)
+    {
+        return fail(NDEF_ERROR_COMPRESSION);
+    }
+    return _status;
+}
+
+void NdefDecompressor::startPayload()
+{
+    if (_payloadLength > _outSize - _typeLength)
+    {
+        fail(NDEF_ERROR_NO_MEMORY);
+        return;
+    }
+    _state = STATE_TOKEN;
+    endToken();
+}
+
+void NdefDecompressor::copyMatch()
+{
+    // only back into the payload, never into the type, and no further
+    // than the payload goes
+    if (_offset == 0 || _offset > _written - _typeLength ||
+        _written + _matchLength > _typeLength + _payloadLength)
+    {
+        fail(NDEF_ERROR_COMPRESSION);
+        return;
+    }
+
+    // byte by byte, a match may overlap what it copies
+    for (unsigned int i = 0; i < _matchLength; i++, _written++)
+    {
+        _out[_written] = _out[_written - _offset];
+    }
+    endToken();
+}
+
+void NdefDecompressor::endToken()
+{
+    _state = _written == _typeLength + _payloadLength ? STATE_DONE : STATE_TOKEN;
+}
+
+NdefStatus NdefDecompressor::fail(NdefStatus status)
+{
+    _status = status;
+    _state = STATE_ERROR;
+    return status;
+}
+
+NdefStatus NdefDecompressor::finish()
+{
+    if (_status == NDEF_OK && _state != STATE_DONE)
+    {
+        fail(NDEF_ERROR_COMPRESSION);
+    }
+    return _status;
+}
+
+byte NdefDecompressor::getTnf() const
+{
+    return _tnf;
+}
+
+NdefSpan NdefDecompressor::getType() const
+{
+    NdefSpan span = { _out, _written < _typeLength ? (unsigned int)_written : _typeLength };
+    return span;
+}
+
+NdefSpan NdefDecompressor::getPayload() const
+{
+    unsigned int length = _written > _typeLength ? _written - _typeLength : 0;
+    NdefSpan span = { &_out[_typeLength], length };
+    return span;
+}
+
+uint32_t NdefDecompressor::getPayloadLength() const
+{
+    return _payloadLength;
+}
@@ -0,0 +1,96 @@
+#ifndef NdefCompression_h
+#define NdefCompression_h
+
+#include <Ndef.h>
+#include <NdefRecord.h>
+
+// A record can be stored compressed inside an external type record. Its
+// payload is a header giving the original TNF, type and payload length,
+// then the payload compressed with a small LZ77 codec. The id stays on
+// the outer record. NdefMessage::addRecord compresses on request and
+// NdefMessage::decode expands such records again.
+
+#ifndef NDEF_COMPRESSED_TYPE
+#define NDEF_COMPRESSED_TYPE "mhamilt.github.io:lz"
+#endif
+#define NDEF_LZ_FORMAT 0x01
+// compressing needs 2 << NDEF_LZ_HASH_BITS bytes of stack
+#ifndef NDEF_LZ_HASH_BITS
+#define NDEF_LZ_HASH_BITS 8
+#endif
+// the most n bytes can grow to, when nothing in them repeats
+#define NDEF_LZ_BOUND(n) ((n) + ((n) + 127) / 128)
+
+// format, tnf, type length, type and 4 byte payload length
+unsigned int NdefCompressedHeaderSize(unsigned int typeLength);
+// Compress length bytes of data into out, which is at least NDEF_LZ_BOUND
+// of them for the worst case. Returns the compressed size, 0 if it did not
+// fit in outSize.
+uint32_t NdefLzCompress(const byte *data, uint32_t length, byte *out, uint32_t outSize);
+
+// a record of NDEF_COMPRESSED_TYPE
+bool NdefIsCompressed(byte tnf, NdefSpan type);
+// bytes the type and payload of a compressed record take once expanded,
+// 0 if its header is cut short or malformed, or claims more than the
+// compressed stream can expand to
+uint32_t NdefDecompressedSize(NdefSpan payload);
+
+// Expands the payload of a compressed record as it arrives, a piece at a
+// time, straight into caller memory: out receives the original type
+// followed by the original payload.
+class NdefDecompressor
+{
+    public:
+        NdefDecompressor(byte *out, uint32_t outSize);
+
+        void reset();
+        // Feed the next numBytes of the compressed record's payload.
+        // Returns NDEF_OK until the data turns out to be bad, then the
+        // error sticks until reset.
+        NdefStatus write(const byte *data, unsigned int numBytes);
+        // NDEF_OK only if the whole payload was expanded
+        NdefStatus finish();
+
+        // the original record, valid once its header has been read
+        byte getTnf() const;
+        NdefSpan getType() const;
+        // as much of the payload as has been expanded
+        NdefSpan getPayload() const;
+        uint32_t getPayloadLength() const;
+    private:
+        enum State
+        {
+            STATE_FORMAT,
+            STATE_TNF,
+            STATE_TYPE_LENGTH,
+            STATE_TYPE,
+            STATE_LENGTH,
+            STATE_TOKEN,
+            STATE_LITERAL,
+            STATE_OFFSET,
+            STATE_MATCH_EXTRA,
+            STATE_DONE,
+            STATE_ERROR
+        };
+
+        void startPayload();
+        void copyMatch();
+        void endToken();
+        NdefStatus fail(NdefStatus status);
+
+        byte *_out;
+        uint32_t _outSize;
+        State _state;
+        NdefStatus _status;
+        byte _tnf;
+        unsigned int _typeLength;
+        uint32_t _payloadLength;
+        // bytes of the type and payload written so far
+        uint32_t _written;
+        // left of the current length field, literal run or type
+        uint32_t _remaining;
+        unsigned int _matchLength;
+        unsigned int _offset;
+};
+
+#endif
@@ -0,0 +1,339 @@
+#include <NdefFormatter.h>
+#include <NdefUri.h>
+
+NdefFormatter::NdefFormatter(Print& out, NdefFormat format)
+{
+    _print = &out;
+    _sink = (NdefSink *)NULL;
+    _format = format;
+    _ok = true;
+    _used = 0;
+}
+
+NdefFormatter::NdefFormatter(NdefSink& out, NdefFormat format)
+{
+    _print = (Print *)NULL;
+    _sink = &out;
+    _format = format;
+    _ok = true;
+    _used = 0;
+}
+
+NdefFormatter::~NdefFormatter()
+{
+    flush();
+}
+
+boolean NdefFormatter::flush()
+{
+    if (_used && _ok)
+    {
+        if (_print)
+        {
+            _ok = _print->write(_buffer, _used) == _used;
+        }
+        else
+        {
+            _ok = _sink->write(_buffer, _used);
+        }
+    }
+    _used = 0;
+    return _ok;
+}
+
+void NdefFormatter::put(byte b)
+{
+    if (_used == sizeof(_buffer))
+    {
+        flush();
+    }
+    _buffer[_used++] = b;
+}
+
+void NdefFormatter::put(const byte *data, unsigned int length)
+{
+    // too big to be worth copying, send it as it is
+    if (length >= sizeof(_buffer))
+    {
+        flush();
+        if (_ok && length)
+        {
+            _ok = _print ? _print->write(data, length) == length : _sink->write(data, length);
+        }
+        return;
+    }
+
+    if (length > sizeof(_buffer) - _used)
+    {
+        flush();
+    }
+    memcpy(&_buffer[_used], data, length);
+    _used += length;
+}
+
+void NdefFormatter::put(const char *text)
+{
+    put((const byte *)text, strlen(text));
+}
+
+void NdefFormatter::put(const __FlashStringHelper *text)
+{
+    const char *p = (const char *)text;
+    for (char c; (c = pgm_read_byte(p)) != 0; p++)
+    {
+        put((byte)c);
+    }
+}
+
+void NdefFormatter::putLine()
+{
+    put('\r');
+    put('\n');
+}
+
+void NdefFormatter::putNumber(uint32_t value, byte base)
+{
+    char digits[10];
+    unsigned int count = 0;
+    do
+    {
+        byte digit = value % base;
+        digits[count++] = digit < 10 ? '0' + digit : 'A' + digit - 10;
+        value /= base;
+    } while (value);
+
+    while (count)
+    {
+        put((byte)digits[--count]);
+    }
+}
+
+void NdefFormatter::putHex(const byte *data, unsigned int length, bool spaced)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    for (unsigned int i = 0; i < length; i++)
+    {
+        if (spaced && i)
+        {
+            put(' ');
+        }
+        put(hex[data[i] >> 4]);
+        put(hex[data[i] & 0xF]);
+    }
+}
+
+void NdefFormatter::putChars(const byte *data, unsigned int length)
+{
+    for (unsigned int i = 0; i < length; i++)
+    {
+        put(data[i] <= 0x1F ? '.' : data[i]);
+    }
+}
+
+// bytes outside ASCII come out as \u00XX, types are ASCII in practice
+void NdefFormatter::putJsonString(const byte *data, unsigned int length)
+{
+    put('"');
+    for (unsigned int i = 0; i < length; i++)
+    {
+        byte b = data[i];
+        if (b == '"' || b == '\\')
+        {
+            put('\\');
+            put(b);
+        }
+        else if (b < 0x20 || b >= 0x7F)
+        {
+            put(F("\\u00"));
+            putHex(&b, 1, false);
+        }
+        else
+        {
+            put(b);
+        }
+    }
+    put('"');
+}
+
+// major type and argument, in the shortest form
+void NdefFormatter::putCborHead(byte major, uint32_t value)
+{
+    major <<= 5;
+    if (value < 24)
+    {
+        put(major | value);
+    }
+    else if (value <= 0xFF)
+    {
+        put(major | 24);
+        put(value);
+    }
+    else if (value <= 0xFFFF)
+    {
+        put(major | 25);
+        put(value >> 8);
+        put(value & 0xFF);
+    }
+    else
+    {
+        put(major | 26);
+        put(value >> 24);
+        put((value >> 16) & 0xFF);
+        put((value >> 8) & 0xFF);
+        put(value & 0xFF);
+    }
+}
+
+void NdefFormatter::putCborKey(const char *key)
+{
+    unsigned int length = strlen(key);
+    putCborHead(3, length);
+    put((const byte *)key, length);
+}
+
+void NdefFormatter::putCborBytes(const byte *data, unsigned int length)
+{
+    putCborHead(2, length);
+    put(data, length);
+}
+
+boolean NdefFormatter::format(const NdefMessageBase& message)
+{
+    unsigned int count = message.getRecordCount();
+
+    if (_format == NDEF_FORMAT_HUMAN)
+    {
+        put('\n');
+        put(F("NDEF Message "));putNumber(count, 10);
+        put(count == 1 ? F(" record, ") : F(" records, "));
+        putNumber(message.getEncodedSize(), 10);put(F(" bytes"));putLine();
+        uint32_t saved = NdefUriBytesSaved(message);
+        if (saved)
+        {
+            put(F("URI prefixes save "));putNumber(saved, 10);put(F(" bytes"));putLine();
+        }
+    }
+    else if (_format == NDEF_FORMAT_JSON)
+    {
+        put(F("{\"size\":"));putNumber(message.getEncodedSize(), 10);
+        put(F(",\"records\":["));
+    }
+    else
+    {
+        putCborHead(5, 2);
+        putCborKey("size");putCborHead(0, message.getEncodedSize());
+        putCborKey("records");putCborHead(4, count);
+    }
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (_format == NDEF_FORMAT_JSON && i)
+        {
+            put(',');
+        }
+        formatRecord(message[i]);
+    }
+
+    if (_format == NDEF_FORMAT_JSON)
+    {
+        put(F("]}"));
+    }
+    return flush();
+}
+
+boolean NdefFormatter::format(const NdefRecord& record)
+{
+    formatRecord(record);
+    return flush();
+}
+
+void NdefFormatter::formatRecord(const NdefRecord& record)
+{
+    switch (_format)
+    {
+        case NDEF_FORMAT_HUMAN:
+            formatHuman(record);
+            break;
+        case NDEF_FORMAT_JSON:
+            formatJson(record);
+            break;
+        default:
+            formatCbor(record);
+            break;
+    }
+}
+
+static const __FlashStringHelper *tnfName(byte tnf)
+{
+    switch (tnf)
+    {
+        case TNF_EMPTY: return F("Empty");
+        case TNF_WELL_KNOWN: return F("Well Known");
+        case TNF_MIME_MEDIA: return F("Mime Media");
+        case TNF_ABSOLUTE_URI: return F("Absolute URI");
+        case TNF_EXTERNAL_TYPE: return F("External");
+        case TNF_UNKNOWN: return F("Unknown");
+        case TNF_UNCHANGED: return F("Unchanged");
+        case TNF_RESERVED: return F("Reserved");
+    }
+    return F("");
+}
+
+void NdefFormatter::formatHuman(const NdefRecord& record)
+{
+    byte tnf = record.getTnf();
+    NdefSpan type = record.getTypeSpan();
+    NdefSpan id = record.getIdSpan();
+    NdefSpan payload = record.getPayloadSpan();
+
+    put(F("  NDEF Record"));putLine();
+    put(F("    TNF 0x"));putNumber(tnf, 16);put(' ');put(tnfName(tnf));putLine();
+    put(F("    Type Length 0x"));putNumber(type.length, 16);put(' ');putNumber(type.length, 10);putLine();
+    put(F("    Payload Length 0x"));putNumber(record.getPayloadLength(), 16);put(' ');
+    putNumber(record.getPayloadLength(), 10);putLine();
+    if (id.length)
+    {
+        put(F("    Id Length 0x"));putNumber(id.length, 16);putLine();
+    }
+    put(F("    Type "));putHex(type.data, type.length, true);put(F("  "));
+    putChars(type.data, type.length);putLine();
+    put(F("    Payload "));putHex(payload.data, payload.length, true);put(F("  "));
+    putChars(payload.data, payload.length);putLine();
+    if (id.length)
+    {
+        put(F("    Id "));putHex(id.data, id.length, true);put(F("  "));
+        putChars(id.data, id.length);putLine();
+    }
+    put(F("    Record is "));putNumber(record.getEncodedSize(), 10);put(F(" bytes"));putLine();
+}
+
+void NdefFormatter::formatJson(const NdefRecord& record)
+{
+    NdefSpan type = record.getTypeSpan();
+    NdefSpan id = record.getIdSpan();
+    NdefSpan payload = record.getPayloadSpan();
+
+    put(F("{\"tnf\":"));putNumber(record.getTnf(), 10);
+    put(F(",\"type\":"));putJsonString(type.data, type.length);
+    if (id.length)
+    {
+        put(F(",\"id\":\""));putHex(id.data, id.length, false);put('"');
+    }
+    put(F(",\"payload\":\""));putHex(payload.data, payload.length, false);put(F("\"}"));
+}
+
+void NdefFormatter::formatCbor(const NdefRecord& record)
+{
+    NdefSpan id = record.getIdSpan();
+    NdefSpan type = record.getTypeSpan();
+    NdefSpan payload = record.getPayloadSpan();
+
+    putCborHead(5, id.length ? 4 : 3);
+    putCborKey("tnf");putCborHead(0, record.getTnf());
+    putCborKey("type");putCborBytes(type.data, type.length);
+    if (id.length)
+    {
+        putCborKey("id");putCborBytes(id.data, id.length);
+    }
+    putCborKey("payload");putCborBytes(payload.data, payload.length);
+}
@@ -0,0 +1,70 @@
+#ifndef NdefFormatter_h
+#define NdefFormatter_h
+
+#include <Ndef.h>
+#include <NdefSink.h>
+#include <NdefMessage.h>
+
+// bytes collected before each write to the output
+#ifndef NDEF_FORMAT_BUFFER
+#define NDEF_FORMAT_BUFFER 64
+#endif
+
+enum NdefFormat
+{
+    NDEF_FORMAT_HUMAN,  // the layout of NdefMessage::print
+    NDEF_FORMAT_JSON,   // one line, payload and id in hex
+    NDEF_FORMAT_CBOR    // RFC 8949, fields as byte strings
+};
+
+// Writes messages and records to a Print, such as Serial, or to a
+// NdefSink. Output is staged in a fixed buffer and goes out in a few large
+// writes instead of one per field or byte. Nothing is allocated.
+//
+// JSON and CBOR messages have the same shape:
+//   {"size": encoded size, "records": [{"tnf": n, "type": .., "id": ..,
+//    "payload": ..}, ...]}
+// with "id" left out when a record has none. JSON gives the type as a
+// string and id and payload as hex strings.
+class NdefFormatter
+{
+    public:
+        NdefFormatter(Print& out, NdefFormat format = NDEF_FORMAT_HUMAN);
+        NdefFormatter(NdefSink& out, NdefFormat format = NDEF_FORMAT_HUMAN);
+        // flushes
+        ~NdefFormatter();
+
+        // both flush, and return false once the output has refused bytes
+        boolean format(const NdefMessageBase& message);
+        boolean format(const NdefRecord& record);
+        // send what is staged
+        boolean flush();
+    private:
+        void formatRecord(const NdefRecord& record);
+        void formatHuman(const NdefRecord& record);
+        void formatJson(const NdefRecord& record);
+        void formatCbor(const NdefRecord& record);
+
+        void put(byte b);
+        void put(const byte *data, unsigned int length);
+        void put(const char *text);
+        void put(const __FlashStringHelper *text);
+        void putLine();
+        void putNumber(uint32_t value, byte base);
+        void putHex(const byte *data, unsigned int length, bool spaced);
+        // printable bytes as is, others as '.'
+        void putChars(const byte *data, unsigned int length);
+        void putJsonString(const byte *data, unsigned int length);
+        void putCborHead(byte major, uint32_t value);
+        void putCborKey(const char *key);
+        void putCborBytes(const byte *data, unsigned int length);
+
+        Print *_print;
+        NdefSink *_sink;
+        NdefFormat _format;
+        boolean _ok;
+        unsigned int _used;
+        byte _buffer[NDEF_FORMAT_BUFFER];
+};
+
+#endif
@@ -1,11 +1,25 @@
 #include <NdefMessage.h>
+#include <NdefUri.h>
+#include <NdefCompression.h>
+#include <NdefFormatter.h>
 
-NdefMessage::NdefMessage(void)
+NdefMessageBase::NdefMessageBase(NdefRecord *records, unsigned int capacity)
 {
+    _records = records;
     _recordCount = 0;
+    _indexedCount = 0;
+    _encodedSize = 0;
+    _recordCapacity = capacity;
+    _recordsOnHeap = false;
+    _fixedRecords = records;
+    _fixedCapacity = capacity;
+    _arena = (byte *)NULL;
+    _arenaSize = 0;
+    _arenaUsed = 0;
+    _arenaOwned = true;
 }
 
-NdefMessage::NdefMessage(const byte * data, const int numBytes)
+NdefStatus NdefMessageBase::decode(const byte * data, unsigned int numBytes)
 {
     #ifdef NDEF_DEBUG
     Serial.print(F("Decoding "));Serial.print(numBytes);Serial.println(F(" bytes"));
@@ -13,262 +27,806 @@ NdefMessage::NdefMessage(const byte * data, const int numBytes)
     //DumpHex(data, numBytes, 16);
     #endif
 
-    _recordCount = 0;
+    clear();
 
-    int index = 0;
+    // the record fields never take more room than the encoded message,
+    // so a single allocation holds them all
+    reserve(numBytes);
 
-    while (index <= numBytes)
+    NdefStatus status = decodeRecords(data, numBytes);
+    if (status == NDEF_OK)
+    {
+        status = expandRecords();
+    }
+    if (status != NDEF_OK)
     {
+        clear();
 
-        // decode tnf - first byte is tnf with bit flags
-        // see the NFDEF spec for more info
-        byte tnf_byte = data[index];
-        bool mb = (tnf_byte & 0x80) != 0;
-        bool me = (tnf_byte & 0x40) != 0;
-        bool cf = (tnf_byte & 0x20) != 0;
-        bool sr = (tnf_byte & 0x10) != 0;
-        bool il = (tnf_byte & 0x8) != 0;
-        byte tnf = (tnf_byte & 0x7);
+        #ifdef NDEF_DEBUG
+        Serial.print(F("Decode failed: "));Serial.println(NdefStatusString(status));
+        #endif
+    }
+    return status;
+}
 
-        NdefRecord record = NdefRecord();
-        record.setTnf(tnf);
+// One pass over the message. NdefRecordView checks each header and its
+// lengths against what is left of the buffer before anything is copied.
+NdefStatus NdefMessageBase::decodeRecords(const byte * data, unsigned int numBytes)
+{
+    if (data == NULL || numBytes == 0)
+    {
+        return NDEF_ERROR_EMPTY;
+    }
 
-        index++;
-        int typeLength = data[index];
+    unsigned int index = 0;
+    bool chunked = false; // the previous record continues in this one
 
-        int payloadLength = 0;
-        if (sr)
+    while (index < numBytes)
+    {
+        NdefRecordView record(&data[index], numBytes - index);
+        if (!record.isValid())
         {
-            index++;
-            payloadLength = data[index];
+            return NDEF_ERROR_TRUNCATED;
         }
-        else
+
+        NdefStatus status = checkRecord(data[index],
+                                        record.getTypeLength(), record.getIdLength(),
+                                        record.getPayloadLength(), index == 0, chunked);
+        if (status != NDEF_OK)
         {
-            payloadLength =
-		((0xFF & data[++index]) << 24)
-		| ((0xFF & data[++index]) << 16)
-		| ((0xFF & data[++index]) << 8)
-		| (0xFF & data[++index]);
+            return status;
         }
 
-        int idLength = 0;
-        if (il)
+        boolean added;
+        if (chunked)
+        {
+            added = appendPayload(record.getPayload(), record.getPayloadLength());
+        }
+        else
+        {
+            added = emplaceRecord(record.getTnf(),
+                                  record.getType(), record.getTypeLength(),
+                                  record.getPayload(), record.getPayloadLength(),
+                                  record.getId(), record.getIdLength());
+        }
+        if (!added)
         {
-            index++;
-            idLength = data[index];
+            return NDEF_ERROR_NO_MEMORY;
         }
 
-        index++;
-        record.setType(&data[index], typeLength);
-        index += typeLength;
+        chunked = record.isChunked();
+        index += record.getEncodedSize();
 
-        if (il)
+        if (record.isMessageEnd())
         {
-            record.setId(&data[index], idLength);
-            index += idLength;
+            // bytes after ME are ignored, tags pad the message area
+            return chunked ? NDEF_ERROR_CHUNK : NDEF_OK;
         }
+    }
 
-        record.setPayload(&data[index], payloadLength);
-        index += payloadLength;
+    return NDEF_ERROR_MESSAGE_END;
+}
+
+NdefStatus NdefMessageBase::checkRecord(byte header, unsigned int typeLength,
+                                    unsigned int idLength, uint32_t payloadLength,
+                                    bool first, bool chunked)
+{
+    if (((header & 0x80) != 0) != first)
+    {
+        return NDEF_ERROR_MESSAGE_BEGIN;
+    }
+
+    byte tnf = header & 0x7;
+    if (tnf == TNF_RESERVED ||
+        (tnf == TNF_EMPTY && (typeLength || idLength || payloadLength)) ||
+        (tnf == TNF_UNKNOWN && typeLength))
+    {
+        return NDEF_ERROR_TNF;
+    }
 
-        addRecord(record);
+    // middle and last chunks carry nothing but payload, and only they
+    // may leave the type unchanged
+    if (chunked != (tnf == TNF_UNCHANGED) ||
+        (chunked && (typeLength || (header & 0x8) != 0)))
+    {
+        return NDEF_ERROR_CHUNK;
+    }
+
+    return NDEF_OK;
+}
 
-        if (me) break; // last message
+// records are dropped, the arena and record table are kept for reuse
+void NdefMessageBase::clear()
+{
+    releaseRecords();
+    _arenaUsed = 0;
+}
+
+// make room for size more bytes of record fields, growing an owned arena
+// in NDEF_ARENA_GROWTH steps
+boolean NdefMessageBase::growArena(unsigned int size)
+{
+    if (_arenaUsed + size <= _arenaSize)
+    {
+        return true;
+    }
+
+    // a length off the wire can be anything
+    if (size > (unsigned int)~0U - _arenaUsed - NDEF_ARENA_GROWTH)
+    {
+        return false;
+    }
+
+    unsigned int grow = _arenaUsed + size + NDEF_ARENA_GROWTH - 1;
+    return reserve(grow - grow % NDEF_ARENA_GROWTH);
+}
+
+// Grow the payload of the last record. Its payload is the last thing in
+// the arena, so the new bytes land right after it.
+boolean NdefMessageBase::appendPayload(const byte *payload, unsigned int payloadLength)
+{
+    if (!growArena(payloadLength))
+    {
+        return false;
+    }
+
+    if (payloadLength)
+    {
+        memcpy(&_arena[_arenaUsed], payload, payloadLength);
+    }
+    // the header may go from short to long form as the payload grows
+    NdefRecord& record = _records[_recordCount - 1];
+    _encodedSize -= record.getEncodedSize();
+    _arenaUsed += payloadLength;
+    record._payloadLength += payloadLength;
+    _encodedSize += record.getEncodedSize();
+    return true;
+}
+
+NdefMessageBase::~NdefMessageBase()
+{
+    // The records only borrow from the arena, so there is nothing to release
+    // one by one. A subclass's inline table is already gone at this point.
+    if (_recordsOnHeap)
+    {
+        delete[] _records;
+    }
+    releaseArena();
+}
+
+// The records keep pointing into the same arena, so they move as is.
+// A heap table changes hands, inline records are moved one at a time.
+void NdefMessageBase::take(NdefMessageBase& rhs)
+{
+    releaseRecords();
+    releaseArena();
+
+    if (rhs._recordsOnHeap)
+    {
+        if (_recordsOnHeap)
+        {
+            delete[] _records;
+        }
+        _records = rhs._records;
+        _recordCapacity = rhs._recordCapacity;
+        _recordsOnHeap = true;
+        _recordCount = rhs._recordCount;
+        _encodedSize = rhs._encodedSize;
+
+        rhs._records = rhs._fixedRecords;
+        rhs._recordCapacity = rhs._fixedCapacity;
+        rhs._recordsOnHeap = false;
+    }
+    else
+    {
+        reserveRecords(rhs._recordCount);
+        _recordCount = rhs._recordCount < _recordCapacity ? rhs._recordCount : _recordCapacity;
+        for (unsigned int i = 0; i < _recordCount; i++)
+        {
+            _records[i].take(rhs._records[i]);
+            _encodedSize += _records[i].getEncodedSize();
+        }
     }
+    _arena = rhs._arena;
+    _arenaSize = rhs._arenaSize;
+    _arenaUsed = rhs._arenaUsed;
+    _arenaOwned = rhs._arenaOwned;
+
+    rhs._recordCount = 0;
+    rhs._indexedCount = 0;
+    rhs._encodedSize = 0;
+    rhs._arena = (byte *)NULL;
+    rhs._arenaSize = 0;
+    rhs._arenaUsed = 0;
+    rhs._arenaOwned = true;
+}
 
+void NdefMessageBase::releaseRecords()
+{
+    for (unsigned int i = 0; i < _recordCount; i++)
+    {
+        _records[i].release();
+    }
+    _recordCount = 0;
+    _indexedCount = 0;
+    _encodedSize = 0;
 }
 
-NdefMessage::NdefMessage(const NdefMessage& rhs)
+// Grow the record table to hold count records, doubling so a run of adds
+// only moves the records a few times. Messages living in a caller's arena
+// never touch the heap, so their table stays where it is.
+boolean NdefMessageBase::reserveRecords(unsigned int count)
 {
+    if (count <= _recordCapacity)
+    {
+        return true;
+    }
+
+    if (!_arenaOwned)
+    {
+        return false;
+    }
 
-    _recordCount = rhs._recordCount;
-    for (int i = 0; i < _recordCount; i++)
+    unsigned int capacity = _recordCapacity * 2;
+    if (capacity < count)
     {
-        _records[i] = rhs._records[i];
+        capacity = count;
     }
 
+    NdefRecord *records = new NdefRecord[capacity];
+    if (records == NULL)
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < _recordCount; i++)
+    {
+        records[i].take(_records[i]);
+    }
+
+    if (_recordsOnHeap)
+    {
+        delete[] _records;
+    }
+    _records = records;
+    _recordCapacity = capacity;
+    _recordsOnHeap = true;
+    return true;
 }
 
-NdefMessage::~NdefMessage()
+void NdefMessageBase::releaseArena()
 {
+    if (_arenaOwned && _arena)
+    {
+        free(_arena);
+    }
+    _arena = (byte *)NULL;
+    _arenaSize = 0;
+    _arenaUsed = 0;
+    _arenaOwned = true;
 }
 
-NdefMessage& NdefMessage::operator=(const NdefMessage& rhs)
+NdefMessageBase& NdefMessageBase::operator=(const NdefMessageBase& rhs)
 {
 
     if (this != &rhs)
     {
 
-        // delete existing records
-        for (int i = 0; i < _recordCount; i++)
+        // delete existing records, keeping the arena and the table
+        releaseRecords();
+        _arenaUsed = 0;
+
+        // a caller's arena that is too small is swapped for one of our own
+        if (!reserve(rhs._arenaUsed))
         {
-            // TODO Dave: is this the right way to delete existing records?
-            _records[i] = NdefRecord();
+            releaseArena();
+            reserve(rhs._arenaUsed);
         }
+        reserveRecords(rhs._recordCount);
 
-        _recordCount = rhs._recordCount;
-        for (int i = 0; i < _recordCount; i++)
+        for (unsigned int i = 0; i < rhs._recordCount; i++)
         {
-            _records[i] = rhs._records[i];
+            addRecord(rhs._records[i]);
         }
     }
     return *this;
 }
 
-unsigned int NdefMessage::getRecordCount()
+NdefMessageBase& NdefMessageBase::operator=(NdefMessageBase&& rhs)
 {
-    return _recordCount;
+    if (this != &rhs)
+    {
+        take(rhs);
+    }
+    return *this;
 }
 
-int NdefMessage::getEncodedSize()
+boolean NdefMessageBase::reserve(unsigned int size)
 {
-    int size = 0;
-    for (int i = 0; i < _recordCount; i++)
+    if (size <= _arenaSize)
     {
-        size += _records[i].getEncodedSize();
+        return true;
     }
-    return size;
+
+    if (!_arenaOwned)
+    {
+        return false;
+    }
+
+    byte *arena = (byte*)malloc(size);
+    if (arena == NULL)
+    {
+        return false;
+    }
+
+    if (_arenaUsed)
+    {
+        memcpy(arena, _arena, _arenaUsed);
+    }
+
+    for (unsigned int i = 0; i < _recordCount; i++)
+    {
+        _records[i].rebase(_arena, arena);
+    }
+
+    free(_arena);
+    _arena = arena;
+    _arenaSize = size;
+    return true;
+}
+
+boolean NdefMessageBase::setArena(byte *arena, unsigned int arenaSize)
+{
+    if (_recordCount)
+    {
+        return false;
+    }
+
+    releaseArena();
+    _arena = arena;
+    _arenaSize = arenaSize;
+    _arenaOwned = false;
+    return true;
+}
+
+unsigned int NdefMessageBase::getArenaSize() const
+{
+    return _arenaSize;
 }
 
-// TODO change this to return uint8_t*
-void NdefMessage::encode(uint8_t* data)
+unsigned int NdefMessageBase::getArenaUsed() const
+{
+    return _arenaUsed;
+}
+
+unsigned int NdefMessageBase::getRecordCount() const
+{
+    return _recordCount;
+}
+
+unsigned int NdefMessageBase::getRecordCapacity() const
+{
+    return _recordCapacity;
+}
+
+// kept up to date as records are added
+uint32_t NdefMessageBase::getEncodedSize() const
+{
+    return _encodedSize;
+}
+
+uint32_t NdefMessageBase::encode(uint8_t* data) const
 {
     // assert sizeof(data) >= getEncodedSize()
     uint8_t* data_ptr = &data[0];
 
-    for (int i = 0; i < _recordCount; i++)
+    for (unsigned int i = 0; i < _recordCount; i++)
     {
-        _records[i].encode(data_ptr, i == 0, (i + 1) == _recordCount);
-        // TODO can NdefRecord.encode return the record size?
-        data_ptr += _records[i].getEncodedSize();
+        data_ptr += _records[i].encode(data_ptr, i == 0, (i + 1) == _recordCount);
     }
 
+    return data_ptr - data;
 }
 
-boolean NdefMessage::addRecord(NdefRecord& record)
+uint32_t NdefMessageBase::encode(NdefSink& sink) const
 {
+    uint32_t size = 0;
 
-    if (_recordCount < MAX_NDEF_RECORDS)
+    for (unsigned int i = 0; i < _recordCount; i++)
     {
-        _records[_recordCount] = record;
-        _recordCount++;
-        return true;
+        uint32_t written = _records[i].encode(sink, i == 0, (i + 1) == _recordCount);
+        if (written == 0)
+        {
+            return 0;
+        }
+        size += written;
     }
-    else
+
+    return size;
+}
+
+boolean NdefMessageBase::addRecord(const NdefRecord& record)
+{
+    return emplaceRecord(record._tnf,
+                         record._type, record._typeLength,
+                         record._payload, record._payloadLength,
+                         record._id, record._idLength);
+}
+
+byte *NdefMessageBase::emplacePayload(byte tnf, const byte *type, unsigned int typeLength,
+                                  uint32_t payloadLength)
+{
+    if (!emplaceRecord(tnf, type, typeLength, NULL, payloadLength))
     {
-        Serial.println(F("WARNING: Too many records. Increase MAX_NDEF_RECORDS."));
-        return false;
+        return (byte *)NULL;
     }
+    return _records[_recordCount - 1]._payload;
 }
 
-void NdefMessage::addMimeMediaRecord(String mimeType, String payload)
+boolean NdefMessageBase::addRecord(const NdefRecord& record, boolean compress)
 {
+    // an empty record has nothing to compress
+    if (!compress || record._tnf == TNF_EMPTY)
+    {
+        return addRecord(record);
+    }
 
-    byte payloadBytes[payload.length() + 1];
-    payload.getBytes(payloadBytes, sizeof(payloadBytes));
+    // adding may move our own records, so find one of them again by index
+    const NdefRecord *source = &record;
+    boolean own = source >= _records && source < _records + _recordCount;
+    unsigned int index = own ? source - _records : 0;
+
+    // room for the worst case, given back once the real size is known
+    unsigned int headerSize = NdefCompressedHeaderSize(record._typeLength);
+    uint32_t bound = NDEF_LZ_BOUND(record._payloadLength);
+    const byte type[] = NDEF_COMPRESSED_TYPE;
+    byte *payload = (byte *)NULL;
+    if (bound > record._payloadLength && bound <= (uint32_t)~0UL - headerSize &&
+        emplaceRecord(TNF_EXTERNAL_TYPE, type, sizeof(type) - 1, NULL, headerSize + bound,
+                      record._id, record._idLength))
+    {
+        payload = _records[_recordCount - 1]._payload;
+    }
+    if (own)
+    {
+        source = &_records[index];
+    }
+    if (!payload)
+    {
+        return addRecord(*source);
+    }
 
-    addMimeMediaRecord(mimeType, payloadBytes, payload.length());
+    payload[0] = NDEF_LZ_FORMAT;
+    payload[1] = source->_tnf;
+    payload[2] = source->_typeLength;
+    memcpy(&payload[3], source->_type, source->_typeLength);
+    byte *length = &payload[headerSize - 4];
+    length[0] = (source->_payloadLength >> 24) & 0xFF;
+    length[1] = (source->_payloadLength >> 16) & 0xFF;
+    length[2] = (source->_payloadLength >> 8) & 0xFF;
+    length[3] = source->_payloadLength & 0xFF;
+
+    uint32_t size = NdefLzCompress(source->_payload, source->_payloadLength,
+                                   &payload[headerSize], bound);
+    shrinkLastPayload(headerSize + size);
+
+    if (size == 0 || _records[_recordCount - 1].getEncodedSize() >= source->getEncodedSize())
+    {
+        dropLastRecord();
+        return addRecord(*source);
+    }
+    return true;
 }
 
-void NdefMessage::addMimeMediaRecord(String mimeType, uint8_t* payload, int payloadLength)
+// The payload of the last record is the last thing in the arena
+void NdefMessageBase::shrinkLastPayload(uint32_t payloadLength)
 {
-    NdefRecord r = NdefRecord();
-    r.setTnf(TNF_MIME_MEDIA);
+    NdefRecord& record = _records[_recordCount - 1];
+    _encodedSize -= record.getEncodedSize();
+    _arenaUsed -= record._payloadLength - payloadLength;
+    record._payloadLength = payloadLength;
+    _encodedSize += record.getEncodedSize();
+}
 
-    byte type[mimeType.length() + 1];
-    mimeType.getBytes(type, sizeof(type));
-    r.setType(type, mimeType.length());
+void NdefMessageBase::dropLastRecord()
+{
+    NdefRecord& record = _records[_recordCount - 1];
+    _encodedSize -= record.getEncodedSize();
+    _arenaUsed -= record._typeLength + record._idLength + record._payloadLength;
+    record.release();
+    _recordCount--;
+    if (_indexedCount > _recordCount)
+    {
+        _indexedCount = _recordCount;
+    }
+}
+
+// Each compressed record is expanded to the end of the arena and pointed
+// there, its compressed bytes are left behind unused.
+NdefStatus NdefMessageBase::expandRecords()
+{
+    for (unsigned int i = 0; i < _recordCount; i++)
+    {
+        NdefRecord& record = _records[i];
+        if (!NdefIsCompressed(record._tnf, record.getTypeSpan()))
+        {
+            continue;
+        }
+
+        uint32_t size = NdefDecompressedSize(record.getPayloadSpan());
+        if (size > (unsigned int)~0U - record._idLength ||
+            !growArena(size + record._idLength))
+        {
+            return NDEF_ERROR_NO_MEMORY;
+        }
 
-    r.setPayload(payload, payloadLength);
+        // growing the arena may have moved the record's bytes
+        byte *storage = &_arena[_arenaUsed];
+        NdefDecompressor decompressor(storage, size);
+        decompressor.write(record._payload, record._payloadLength);
+        byte tnf = decompressor.getTnf();
+        if (decompressor.finish() != NDEF_OK ||
+            tnf == TNF_EMPTY || tnf == TNF_UNCHANGED || tnf == TNF_RESERVED)
+        {
+            return NDEF_ERROR_COMPRESSION;
+        }
+
+        if (record._idLength)
+        {
+            memcpy(&storage[size], record._id, record._idLength);
+        }
 
-    addRecord(r);
+        _encodedSize -= record.getEncodedSize();
+        record._tnf = tnf;
+        record._typeLength = decompressor.getType().length;
+        record._type = storage;
+        record._payloadLength = decompressor.getPayloadLength();
+        record._payload = &storage[record._typeLength];
+        record._id = &storage[size];
+        _arenaUsed += size + record._idLength;
+        _encodedSize += record.getEncodedSize();
+        _indexedCount = 0;
+    }
+    return NDEF_OK;
 }
 
-void NdefMessage::addTextRecord(String text)
+// where field is in the used part of the arena, -1 if it is not there
+long NdefMessageBase::arenaOffset(const byte *field) const
 {
-    addTextRecord(text, "en");
+    if (field && _arena && field >= _arena && field < _arena + _arenaUsed)
+    {
+        return field - _arena;
+    }
+    return -1;
 }
 
-void NdefMessage::addTextRecord(String text, String encoding)
+// copy the record fields into the arena, growing it if we own it
+boolean NdefMessageBase::emplaceRecord(byte tnf,
+                                   const byte *type, unsigned int typeLength,
+                                   const byte *payload, uint32_t payloadLength,
+                                   const byte *id, unsigned int idLength)
 {
-    NdefRecord r = NdefRecord();
-    r.setTnf(TNF_WELL_KNOWN);
+    if (!reserveRecords(_recordCount + 1))
+    {
+        Serial.println(F("WARNING: Out of room for NDEF records."));
+        return false;
+    }
 
-    uint8_t RTD_TEXT[1] = { 0x54 }; // TODO this should be a constant or preprocessor
-    r.setType(RTD_TEXT, sizeof(RTD_TEXT));
+    // the fields have to fit in the arena, whose size is an unsigned int
+    if (payloadLength > (unsigned int)~0U - typeLength - idLength)
+    {
+        Serial.println(F("WARNING: Out of room for NDEF record fields."));
+        return false;
+    }
 
-    // X is a placeholder for encoding length
-    // TODO is it more efficient to build w/o string concatenation?
-    String payloadString = "X" + encoding + text;
+    // Fields from this message's own arena, as in addRecord(message[0]),
+    // would be left behind if it moves, so hold them as offsets meanwhile.
+    long typeOffset = arenaOffset(type);
+    long payloadOffset = arenaOffset(payload);
+    long idOffset = arenaOffset(id);
 
-    byte payload[payloadString.length() + 1];
-    payloadString.getBytes(payload, sizeof(payload));
+    unsigned int size = typeLength + idLength + payloadLength;
+    if (!growArena(size))
+    {
+        Serial.println(F("WARNING: Out of room for NDEF record fields."));
+        return false;
+    }
 
-    // replace X with the real encoding length
-    payload[0] = encoding.length();
+    if (typeOffset >= 0)
+    {
+        type = &_arena[typeOffset];
+    }
+    if (payloadOffset >= 0)
+    {
+        payload = &_arena[payloadOffset];
+    }
+    if (idOffset >= 0)
+    {
+        id = &_arena[idOffset];
+    }
+
+    _records[_recordCount].borrow(&_arena[_arenaUsed], tnf,
+                                  type, typeLength,
+                                  id, idLength,
+                                  payload, payloadLength);
+    _arenaUsed += size;
+    _encodedSize += _records[_recordCount].getEncodedSize();
+    _recordCount++;
+    return true;
+}
+
+static const byte RTD_TEXT[] = { 0x54 };
+static const byte RTD_URI[] = { 0x55 };
+
+void NdefMessageBase::addMimeMediaRecord(String mimeType, String payload)
+{
+    addMimeMediaRecord(mimeType.c_str(), (const byte *)payload.c_str(), payload.length());
+}
+
+void NdefMessageBase::addMimeMediaRecord(String mimeType, const uint8_t* payload, uint32_t payloadLength)
+{
+    addMimeMediaRecord(mimeType.c_str(), payload, payloadLength);
+}
+
+boolean NdefMessageBase::addMimeMediaRecord(const char *mimeType, const byte *payload, uint32_t payloadLength)
+{
+    return emplaceRecord(TNF_MIME_MEDIA, (const byte *)mimeType, strlen(mimeType),
+                         payload, payloadLength);
+}
 
-    r.setPayload(payload, payloadString.length());
+boolean NdefMessageBase::addMimeMediaRecord(const char *mimeType, const char *payload)
+{
+    return addMimeMediaRecord(mimeType, (const byte *)payload, strlen(payload));
+}
+
+void NdefMessageBase::addTextRecord(String text)
+{
+    addTextRecord(text, "en");
+}
+
+void NdefMessageBase::addTextRecord(String text, String encoding)
+{
+    NdefSpan textSpan = { (const byte *)text.c_str(), text.length() };
+    NdefSpan languageSpan = { (const byte *)encoding.c_str(), encoding.length() };
+    addTextRecord(textSpan, languageSpan);
+}
 
-    addRecord(r);
+boolean NdefMessageBase::addTextRecord(const char *text, const char *language)
+{
+    NdefSpan textSpan = { (const byte *)text, (unsigned int)strlen(text) };
+    NdefSpan languageSpan = { (const byte *)language, (unsigned int)strlen(language) };
+    return addTextRecord(textSpan, languageSpan);
 }
 
-void NdefMessage::addUriRecord(String uri)
+boolean NdefMessageBase::addTextRecord(NdefSpan text, NdefSpan language)
 {
-    NdefRecord* r = new NdefRecord();
-    r->setTnf(TNF_WELL_KNOWN);
+    // the status byte holds the language length in its low 6 bits
+    if (language.length > 0x3F)
+    {
+        Serial.println(F("WARNING: NDEF text language code too long."));
+        return false;
+    }
+
+    byte *payload = emplacePayload(TNF_WELL_KNOWN, RTD_TEXT, sizeof(RTD_TEXT),
+                                   1 + (uint32_t)language.length + text.length);
+    if (!payload)
+    {
+        return false;
+    }
 
-    uint8_t RTD_URI[1] = { 0x55 }; // TODO this should be a constant or preprocessor
-    r->setType(RTD_URI, sizeof(RTD_URI));
+    // bit 7 clear for UTF-8
+    payload[0] = language.length;
+    memcpy(&payload[1], language.data, language.length);
+    memcpy(&payload[1 + language.length], text.data, text.length);
+    return true;
+}
 
-    // X is a placeholder for identifier code
-    String payloadString = "X" + uri;
+void NdefMessageBase::addUriRecord(String uri)
+{
+    NdefSpan uriSpan = { (const byte *)uri.c_str(), uri.length() };
+    addUriRecord(uriSpan);
+}
 
-    byte payload[payloadString.length() + 1];
-    payloadString.getBytes(payload, sizeof(payload));
+boolean NdefMessageBase::addUriRecord(const char *uri)
+{
+    NdefSpan uriSpan = { (const byte *)uri, (unsigned int)strlen(uri) };
+    return addUriRecord(uriSpan);
+}
 
-    // add identifier code 0x0, meaning no prefix substitution
-    payload[0] = 0x0;
+boolean NdefMessageBase::addUriRecord(NdefSpan uri)
+{
+    // the identifier code stands in for the longest standard prefix
+    byte code = NdefUriAbbreviate(uri.data, uri.length);
+    unsigned int prefixLength = NdefUriPrefixLength(code);
 
-    r->setPayload(payload, payloadString.length());
+    byte *payload = emplacePayload(TNF_WELL_KNOWN, RTD_URI, sizeof(RTD_URI),
+                                   1 + (uint32_t)uri.length - prefixLength);
+    if (!payload)
+    {
+        return false;
+    }
 
-    addRecord(*r);
-    delete(r);
+    payload[0] = code;
+    memcpy(&payload[1], &uri.data[prefixLength], uri.length - prefixLength);
+    return true;
 }
 
-void NdefMessage::addEmptyRecord()
+void NdefMessageBase::addEmptyRecord()
 {
-    NdefRecord* r = new NdefRecord();
-    r->setTnf(TNF_EMPTY);
-    addRecord(*r);
-    delete(r);
+    emplaceRecord(TNF_EMPTY, NULL, 0, NULL, 0);
 }
 
-NdefRecord NdefMessage::getRecord(int index)
+const NdefRecord& NdefMessageBase::getRecord(int index) const
 {
-    if (index > -1 && index < _recordCount)
+    static const NdefRecord empty;
+
+    if (index > -1 && index < (int)_recordCount)
     {
         return _records[index];
     }
     else
     {
-        return NdefRecord(); // would rather return NULL
+        return empty; // would rather return NULL
     }
 }
 
-NdefRecord NdefMessage::operator[](int index)
+const NdefRecord& NdefMessageBase::operator[](int index) const
 {
     return getRecord(index);
 }
 
-void NdefMessage::print()
+static byte typeHash(byte tnf, const byte *type, unsigned int typeLength)
+{
+    byte hash = tnf;
+    for (unsigned int i = 0; i < typeLength; i++)
+    {
+        hash = hash * 31 + type[i];
+    }
+    return hash;
+}
+
+void NdefMessageBase::indexRecords() const
 {
-    Serial.print(F("\nNDEF Message "));Serial.print(_recordCount);Serial.print(F(" record"));
-    _recordCount == 1 ? Serial.print(", ") : Serial.print("s, ");
-    Serial.print(getEncodedSize());Serial.println(F(" bytes"));
+    for (; _indexedCount < _recordCount; _indexedCount++)
+    {
+        NdefRecord& record = _records[_indexedCount];
+        record._typeHash = typeHash(record._tnf, record._type, record._typeLength);
+    }
+}
+
+int NdefMessageBase::findRecordIndex(byte tnf, const byte *type, unsigned int typeLength,
+                                 unsigned int from) const
+{
+    indexRecords();
 
-    int i;
-    for (i = 0; i < _recordCount; i++)
+    byte hash = typeHash(tnf, type, typeLength);
+    for (unsigned int i = from; i < _recordCount; i++)
     {
-         _records[i].print();
+        const NdefRecord& record = _records[i];
+        // the hash rules out almost every other record before a compare
+        if (record._typeHash == hash && record._tnf == tnf &&
+            record._typeLength == typeLength &&
+            (typeLength == 0 || memcmp(record._type, type, typeLength) == 0))
+        {
+            return i;
+        }
     }
+    return -1;
+}
+
+const NdefRecord *NdefMessageBase::findRecord(byte tnf, const byte *type, unsigned int typeLength) const
+{
+    int index = findRecordIndex(tnf, type, typeLength);
+    return index < 0 ? (const NdefRecord *)NULL : &_records[index];
+}
+
+const NdefRecord *NdefMessageBase::findRecord(byte tnf, const char *type) const
+{
+    return findRecord(tnf, (const byte *)type, strlen(type));
+}
+
+void NdefMessageBase::print() const
+{
+    NdefFormatter formatter(Serial);
+    formatter.format(*this);
 }
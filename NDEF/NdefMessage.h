@@ -3,37 +3,226 @@
 
 #include <Ndef.h>
 #include <NdefRecord.h>
+#include <NdefView.h>
 
+// records a NdefMessage holds before its table spills to the heap; also
+// all a NdefMessage in a caller's arena can hold
+#ifndef NDEF_INLINE_RECORDS
+#define NDEF_INLINE_RECORDS 4
+#endif
+// Deprecated: no longer a limit, use NDEF_INLINE_RECORDS or NdefMessageN.
+// Kept at its old value for sketches that size arrays by it.
 #define MAX_NDEF_RECORDS 4
+// an owned arena grows in steps of this many bytes
+#define NDEF_ARENA_GROWTH 32
 
-class NdefMessage
+// Everything a message does, over a record table its subclass provides;
+// see NdefMessageN. Functions that take any message take this.
+class NdefMessageBase
 {
+    friend class NdefStreamDecoder;
+
     public:
-        NdefMessage(void);
-        NdefMessage(const byte *data, const int numBytes);
-        NdefMessage(const NdefMessage& rhs);
-        ~NdefMessage();
-        NdefMessage& operator=(const NdefMessage& rhs);
+        NdefMessageBase& operator=(const NdefMessageBase& rhs);
+        // takes over the records and arena of rhs, leaving it empty
+        NdefMessageBase& operator=(NdefMessageBase&& rhs);
+
+        uint32_t getEncodedSize() const; // need so we can pass array to encode
+        // both return the number of bytes written; the sink version writes
+        // in one pass without a buffer for the whole message, returning 0
+        // if the sink refused the bytes
+        uint32_t encode(byte *data) const;
+        uint32_t encode(NdefSink& sink) const;
+        // Replace the records with those in data, checking every length
+        // against numBytes. Chunked records are joined back into one and
+        // compressed records expanded. On error the message is left empty.
+        NdefStatus decode(const byte *data, unsigned int numBytes);
 
-        int getEncodedSize(); // need so we can pass array to encode
-        void encode(byte *data);
+        // Records keep their type, id and payload in arena, which must
+        // outlive the message. Nothing is allocated; adds fail once it is
+        // full or the inline record table is. Only allowed while the
+        // message has no records.
+        boolean setArena(byte *arena, unsigned int arenaSize);
+        // make room for size bytes of record fields up front
+        boolean reserve(unsigned int size);
+        unsigned int getArenaSize() const;
+        unsigned int getArenaUsed() const;
 
-        boolean addRecord(NdefRecord& record);
+        boolean addRecord(const NdefRecord& record);
+        // With compress, store the record inside a NDEF_COMPRESSED_TYPE
+        // record if that makes it smaller, see NdefCompression.h. It is
+        // added as is when compressing does not pay.
+        boolean addRecord(const NdefRecord& record, boolean compress);
+        // build a record straight into the arena, copying each field once
+        boolean emplaceRecord(byte tnf,
+                              const byte *type, unsigned int typeLength,
+                              const byte *payload, uint32_t payloadLength,
+                              const byte *id = NULL, unsigned int idLength = 0);
         void addMimeMediaRecord(String mimeType, String payload);
-        void addMimeMediaRecord(String mimeType, byte *payload, int payloadLength);
+        void addMimeMediaRecord(String mimeType, const byte *payload, uint32_t payloadLength);
         void addTextRecord(String text);
         void addTextRecord(String text, String encoding);
+        // the longest standard prefix of uri is stored as its one byte
+        // code, see NdefUri.h
         void addUriRecord(String uri);
+        // The same records without String temporaries. The status byte,
+        // language and text go straight into the arena, one copy each.
+        // Return false if the record did not fit.
+        boolean addMimeMediaRecord(const char *mimeType, const byte *payload, uint32_t payloadLength);
+        boolean addMimeMediaRecord(const char *mimeType, const char *payload);
+        boolean addTextRecord(const char *text, const char *language = "en");
+        // text and language need not be NUL terminated; a language code
+        // has at most 63 bytes
+        boolean addTextRecord(NdefSpan text, NdefSpan language);
+        boolean addUriRecord(const char *uri);
+        boolean addUriRecord(NdefSpan uri);
         void addEmptyRecord();
 
-        unsigned int getRecordCount();
-        NdefRecord getRecord(int index);
-        NdefRecord operator[](int index);
+        unsigned int getRecordCount() const;
+        // records that fit before the table has to grow
+        unsigned int getRecordCapacity() const;
+        // the record in place, or an empty record if index is out of range;
+        // valid until the message changes
+        const NdefRecord& getRecord(int index) const;
+        const NdefRecord& operator[](int index) const;
+
+        // Lookups by tnf and type. The first one hashes the type of every
+        // record; later ones compare a byte per record until a hash matches,
+        // hashing only records added since.
+        // the index of the first matching record at or after from, or -1
+        int findRecordIndex(byte tnf, const byte *type, unsigned int typeLength,
+                            unsigned int from = 0) const;
+        // the first matching record in place, NULL if there is none;
+        // valid until the message changes
+        const NdefRecord *findRecord(byte tnf, const byte *type, unsigned int typeLength) const;
+        const NdefRecord *findRecord(byte tnf, const char *type) const;
+        // call visit with every matching record in turn, a function or a
+        // lambda taking a const NdefRecord&; returns how many there were
+        template <typename Visitor>
+        unsigned int forEachRecord(byte tnf, const char *type, Visitor visit) const
+        {
+            unsigned int count = 0;
+            unsigned int typeLength = strlen(type);
+            for (int i = findRecordIndex(tnf, (const byte *)type, typeLength);
+                 i >= 0;
+                 i = findRecordIndex(tnf, (const byte *)type, typeLength, i + 1))
+            {
+                visit(_records[i]);
+                count++;
+            }
+            return count;
+        }
 
-        void print();
+        void print() const;
+    protected:
+        // records is the subclass's table of capacity records, not yet
+        // constructed when this runs
+        NdefMessageBase(NdefRecord *records, unsigned int capacity);
+        ~NdefMessageBase();
+        void take(NdefMessageBase& rhs);
     private:
-        NdefRecord _records[MAX_NDEF_RECORDS];
+        NdefMessageBase(const NdefMessageBase& rhs);
+        NdefStatus decodeRecords(const byte *data, unsigned int numBytes);
+        // what a record header must satisfy; first is true for the first
+        // record, chunked when the previous record continues into this one
+        static NdefStatus checkRecord(byte header, unsigned int typeLength,
+                                      unsigned int idLength, uint32_t payloadLength,
+                                      bool first, bool chunked);
+        // add a record with room for its payload, which the caller fills;
+        // NULL if it did not fit
+        byte *emplacePayload(byte tnf, const byte *type, unsigned int typeLength,
+                             uint32_t payloadLength);
+        // replace compressed records with what they hold
+        NdefStatus expandRecords();
+        void shrinkLastPayload(uint32_t payloadLength);
+        void dropLastRecord();
+        boolean growArena(unsigned int size);
+        long arenaOffset(const byte *field) const;
+        boolean appendPayload(const byte *payload, unsigned int payloadLength);
+        void clear();
+        // bring the type hashes up to the last record
+        void indexRecords() const;
+        boolean reserveRecords(unsigned int count);
+        void releaseRecords();
+        void releaseArena();
+        // the subclass's table or a heap table
+        NdefRecord *_records;
         unsigned int _recordCount;
+        // records whose type hash is up to date, the rest are hashed on
+        // the next lookup
+        mutable unsigned int _indexedCount;
+        uint32_t _encodedSize;
+        unsigned int _recordCapacity;
+        boolean _recordsOnHeap;
+        // the table to fall back to when a heap table is handed away
+        NdefRecord *_fixedRecords;
+        unsigned int _fixedCapacity;
+        // type, id and payload bytes of every record, back to back
+        byte *_arena;
+        unsigned int _arenaSize;
+        unsigned int _arenaUsed;
+        boolean _arenaOwned;
 };
 
-#endif
\ No newline at end of file
+// A message that holds N records before touching the heap, and no more
+// than N in a caller's arena. Small N makes for a small message.
+template <unsigned int N>
+class NdefMessageN : public NdefMessageBase
+{
+    public:
+        NdefMessageN(void) : NdefMessageBase(_storage, N) {}
+        NdefMessageN(const byte *data, const int numBytes) : NdefMessageBase(_storage, N)
+        {
+            decode(data, numBytes > 0 ? numBytes : 0);
+        }
+        // decode into a caller's arena, see setArena
+        NdefMessageN(const byte *data, const int numBytes, byte *arena, unsigned int arenaSize)
+            : NdefMessageBase(_storage, N)
+        {
+            setArena(arena, arenaSize);
+            decode(data, numBytes > 0 ? numBytes : 0);
+        }
+        NdefMessageN(const NdefMessageN& rhs) : NdefMessageBase(_storage, N)
+        {
+            NdefMessageBase::operator=(rhs);
+        }
+        NdefMessageN(const NdefMessageBase& rhs) : NdefMessageBase(_storage, N)
+        {
+            NdefMessageBase::operator=(rhs);
+        }
+        // takes over the records and arena of rhs, leaving it empty
+        NdefMessageN(NdefMessageN&& rhs) : NdefMessageBase(_storage, N)
+        {
+            take(rhs);
+        }
+        NdefMessageN(NdefMessageBase&& rhs) : NdefMessageBase(_storage, N)
+        {
+            take(rhs);
+        }
+        NdefMessageN& operator=(const NdefMessageN& rhs)
+        {
+            NdefMessageBase::operator=(rhs);
+            return *this;
+        }
+        NdefMessageN& operator=(const NdefMessageBase& rhs)
+        {
+            NdefMessageBase::operator=(rhs);
+            return *this;
+        }
+        NdefMessageN& operator=(NdefMessageN&& rhs)
+        {
+            NdefMessageBase::operator=(static_cast<NdefMessageBase&&>(rhs));
+            return *this;
+        }
+        NdefMessageN& operator=(NdefMessageBase&& rhs)
+        {
+            NdefMessageBase::operator=(static_cast<NdefMessageBase&&>(rhs));
+            return *this;
+        }
+    private:
+        NdefRecord _storage[N];
+};
+
+typedef NdefMessageN<NDEF_INLINE_RECORDS> NdefMessage;
+
+#endif
@@ -1,8 +1,11 @@
 #include "NdefRecord.h"
+#include "NdefFormatter.h"
 
 NdefRecord::NdefRecord()
 {
     //Serial.println("NdefRecord Constructor 1");
+    _borrowed = false;
+    _typeHash = 0;
     _tnf = 0;
     _typeLength = 0;
     _payloadLength = 0;
@@ -16,6 +19,9 @@ NdefRecord::NdefRecord(const NdefRecord& rhs)
 {
     //Serial.println("NdefRecord Constructor 2 (copy)");
 
+    // a copy always owns its bytes, even if rhs borrows them
+    _borrowed = false;
+    _typeHash = 0;
     _tnf = rhs._tnf;
     _typeLength = rhs._typeLength;
     _payloadLength = rhs._payloadLength;
@@ -44,48 +50,169 @@ NdefRecord::NdefRecord(const NdefRecord& rhs)
 
 }
 
+NdefRecord::NdefRecord(NdefRecord&& rhs)
+{
+    _borrowed = false;
+    _typeHash = 0;
+    _typeLength = 0;
+    _payloadLength = 0;
+    _idLength = 0;
+    _type = (byte *)NULL;
+    _payload = (byte *)NULL;
+    _id = (byte *)NULL;
+
+    take(rhs);
+}
+
 // TODO NdefRecord::NdefRecord(tnf, type, payload, id)
 
 NdefRecord::~NdefRecord()
 {
     //Serial.println("NdefRecord Destructor");
-    if (_typeLength)
+    release();
+}
+
+// free the byte fields, unless they belong to a message arena
+void NdefRecord::release()
+{
+    if (!_borrowed)
     {
-        free(_type);
+        if (_typeLength)
+        {
+            free(_type);
+        }
+
+        if (_payloadLength)
+        {
+            free(_payload);
+        }
+
+        if (_idLength)
+        {
+            free(_id);
+        }
+    }
+    _borrowed = false;
+    _typeLength = 0;
+    _payloadLength = 0;
+    _idLength = 0;
+    _type = (byte *)NULL;
+    _payload = (byte *)NULL;
+    _id = (byte *)NULL;
+}
+
+// Move the fields of rhs here, borrowed or not, and leave rhs empty.
+void NdefRecord::take(NdefRecord& rhs)
+{
+    release();
+    _borrowed = rhs._borrowed;
+    _tnf = rhs._tnf;
+    _typeHash = rhs._typeHash;
+    _typeLength = rhs._typeLength;
+    _payloadLength = rhs._payloadLength;
+    _idLength = rhs._idLength;
+    _type = rhs._type;
+    _payload = rhs._payload;
+    _id = rhs._id;
+
+    rhs._borrowed = false;
+    rhs._tnf = 0;
+    rhs._typeLength = 0;
+    rhs._payloadLength = 0;
+    rhs._idLength = 0;
+    rhs._type = (byte *)NULL;
+    rhs._payload = (byte *)NULL;
+    rhs._id = (byte *)NULL;
+}
+
+// Point the byte fields at storage (type, id, then payload) after
+// copying them there. Called by NdefMessage with space in its arena.
+void NdefRecord::borrow(byte *storage, byte tnf,
+                        const byte *type, unsigned int typeLength,
+                        const byte *id, unsigned int idLength,
+                        const byte *payload, uint32_t payloadLength)
+{
+    release();
+    _borrowed = true;
+    _tnf = tnf;
+    _typeLength = typeLength;
+    _idLength = idLength;
+    _payloadLength = payloadLength;
+
+    _type = storage;
+    _id = _type + typeLength;
+    _payload = _id + idLength;
+
+    if (typeLength)
+    {
+        memcpy(_type, type, typeLength);
     }
 
-    if (_payloadLength)
+    if (idLength)
     {
-        free(_payload);
+        memcpy(_id, id, idLength);
     }
 
-    if (_idLength)
+    // a NULL payload leaves the bytes for the caller to fill
+    if (payload && payloadLength)
     {
-        free(_id);
+        memcpy(_payload, payload, payloadLength);
     }
 }
 
-NdefRecord& NdefRecord::operator=(const NdefRecord& rhs)
+// the arena moved from one block to another
+void NdefRecord::rebase(const byte *from, byte *to)
 {
-    //Serial.println("NdefRecord ASSIGN");
+    if (_borrowed)
+    {
+        _type = to + (_type - from);
+        _id = to + (_id - from);
+        _payload = to + (_payload - from);
+    }
+}
 
-    if (this != &rhs)
+// take a private copy of borrowed bytes before changing them
+void NdefRecord::detach()
+{
+    if (_borrowed)
     {
-        // free existing
+        byte *type = _type;
+        byte *payload = _payload;
+        byte *id = _id;
+
+        _borrowed = false;
+        _type = (byte *)NULL;
+        _payload = (byte *)NULL;
+        _id = (byte *)NULL;
+
         if (_typeLength)
         {
-            free(_type);
+            _type = (byte*)malloc(_typeLength);
+            memcpy(_type, type, _typeLength);
         }
 
         if (_payloadLength)
         {
-            free(_payload);
+            _payload = (byte*)malloc(_payloadLength);
+            memcpy(_payload, payload, _payloadLength);
         }
 
         if (_idLength)
         {
-            free(_id);
+            _id = (byte*)malloc(_idLength);
+            memcpy(_id, id, _idLength);
         }
+    }
+}
+
+NdefRecord& NdefRecord::operator=(const NdefRecord& rhs)
+{
+    //Serial.println("NdefRecord ASSIGN");
+
+    if (this != &rhs)
+    {
+        // free existing
+        release();
 
         _tnf = rhs._tnf;
         _typeLength = rhs._typeLength;
@@ -113,10 +240,19 @@ NdefRecord& NdefRecord::operator=(const NdefRecord& rhs)
     return *this;
 }
 
+NdefRecord& NdefRecord::operator=(NdefRecord&& rhs)
+{
+    if (this != &rhs)
+    {
+        take(rhs);
+    }
+    return *this;
+}
+
 // size of records in bytes
-int NdefRecord::getEncodedSize()
+uint32_t NdefRecord::getEncodedSize() const
 {
-    int size = 2; // tnf + typeLength
+    uint32_t size = 2; // tnf + typeLength
     if (_payloadLength > 0xFF)
     {
         size += 4;
@@ -136,10 +272,8 @@ int NdefRecord::getEncodedSize()
     return size;
 }
 
-void NdefRecord::encode(byte *data, bool firstRecord, bool lastRecord)
+unsigned int NdefRecord::encodeHeader(byte *data, bool firstRecord, bool lastRecord) const
 {
-    // assert data > getEncodedSize()
-
     uint8_t* data_ptr = &data[0];
 
     *data_ptr = getTnfByte(firstRecord, lastRecord);
@@ -152,9 +286,8 @@ void NdefRecord::encode(byte *data, bool firstRecord, bool lastRecord)
         *data_ptr = _payloadLength;
         data_ptr += 1;
     } else { // long format
-        // 4 bytes but we store length as an int
-        data_ptr[0] = 0x0; // (_payloadLength >> 24) & 0xFF;
-        data_ptr[1] = 0x0; // (_payloadLength >> 16) & 0xFF;
+        data_ptr[0] = (_payloadLength >> 24) & 0xFF;
+        data_ptr[1] = (_payloadLength >> 16) & 0xFF;
         data_ptr[2] = (_payloadLength >> 8) & 0xFF;
         data_ptr[3] = _payloadLength & 0xFF;
         data_ptr += 4;
@@ -166,21 +299,55 @@ void NdefRecord::encode(byte *data, bool firstRecord, bool lastRecord)
         data_ptr += 1;
     }
 
-    //Serial.println(2);
-    memcpy(data_ptr, _type, _typeLength);
-    data_ptr += _typeLength;
+    return data_ptr - data;
+}
+
+uint32_t NdefRecord::encode(byte *data, bool firstRecord, bool lastRecord) const
+{
+    // assert data > getEncodedSize()
+
+    uint8_t* data_ptr = &data[0];
+    data_ptr += encodeHeader(data_ptr, firstRecord, lastRecord);
+
+    if (_typeLength)
+    {
+        memcpy(data_ptr, _type, _typeLength);
+        data_ptr += _typeLength;
+    }
 
     if (_idLength)
     {
         memcpy(data_ptr, _id, _idLength);
         data_ptr += _idLength;
     }
-    
-    memcpy(data_ptr, _payload, _payloadLength);
-    data_ptr += _payloadLength;
+
+    if (_payloadLength)
+    {
+        memcpy(data_ptr, _payload, _payloadLength);
+        data_ptr += _payloadLength;
+    }
+
+    return data_ptr - data;
 }
 
-byte NdefRecord::getTnfByte(bool firstRecord, bool lastRecord)
+// the fields go to the sink straight from where they are kept
+uint32_t NdefRecord::encode(NdefSink& sink, bool firstRecord, bool lastRecord) const
+{
+    byte header[7];
+    unsigned int headerLength = encodeHeader(header, firstRecord, lastRecord);
+
+    if (!sink.write(header, headerLength) ||
+        !sink.write(_type, _typeLength) ||
+        !sink.write(_id, _idLength) ||
+        !sink.write(_payload, _payloadLength))
+    {
+        return 0;
+    }
+
+    return headerLength + _typeLength + _idLength + _payloadLength;
+}
+
+byte NdefRecord::getTnfByte(bool firstRecord, bool lastRecord) const
 {
     int value = _tnf;
 
@@ -192,10 +359,7 @@ byte NdefRecord::getTnfByte(bool firstRecord, bool lastRecord)
         value = value | 0x40;
     }
 
-    // chunked flag is always false for now
-    // if (cf) {
-    //     value = value | 0x20;
-    // }
+    // never chunked, decoding joins chunks back into one record
 
     if (_payloadLength <= 0xFF) {
         value = value | 0x10;
@@ -208,7 +372,7 @@ byte NdefRecord::getTnfByte(bool firstRecord, bool lastRecord)
     return value;
 }
 
-byte NdefRecord::getTnf()
+byte NdefRecord::getTnf() const
 {
     return _tnf;
 }
@@ -218,22 +382,22 @@ void NdefRecord::setTnf(byte tnf)
     _tnf = tnf;
 }
 
-unsigned int NdefRecord::getTypeLength()
+unsigned int NdefRecord::getTypeLength() const
 {
     return _typeLength;
 }
 
-int NdefRecord::getPayloadLength()
+uint32_t NdefRecord::getPayloadLength() const
 {
     return _payloadLength;
 }
 
-unsigned int NdefRecord::getIdLength()
+unsigned int NdefRecord::getIdLength() const
 {
     return _idLength;
 }
 
-String NdefRecord::getType()
+String NdefRecord::getType() const
 {
     char type[_typeLength + 1];
     memcpy(type, _type, _typeLength);
@@ -242,13 +406,14 @@ String NdefRecord::getType()
 }
 
 // this assumes the caller created type correctly
-void NdefRecord::getType(uint8_t* type)
+void NdefRecord::getType(uint8_t* type) const
 {
     memcpy(type, _type, _typeLength);
 }
 
 void NdefRecord::setType(const byte * type, const unsigned int numBytes)
 {
+    detach();
     if(_typeLength)
     {
         free(_type);
@@ -260,13 +425,38 @@ void NdefRecord::setType(const byte * type, const unsigned int numBytes)
 }
 
 // assumes the caller sized payload properly
-void NdefRecord::getPayload(byte *payload)
+void NdefRecord::getPayload(byte *payload) const
 {
     memcpy(payload, _payload, _payloadLength);
 }
 
-void NdefRecord::setPayload(const byte * payload, const int numBytes)
+const byte *NdefRecord::getPayload() const
+{
+    return _payload;
+}
+
+NdefSpan NdefRecord::getTypeSpan() const
 {
+    NdefSpan span = { _type, _typeLength };
+    return span;
+}
+
+NdefSpan NdefRecord::getIdSpan() const
+{
+    NdefSpan span = { _id, _idLength };
+    return span;
+}
+
+NdefSpan NdefRecord::getPayloadSpan() const
+{
+    // a payload held in RAM fits an unsigned int
+    NdefSpan span = { _payload, (unsigned int)_payloadLength };
+    return span;
+}
+
+void NdefRecord::setPayload(const byte * payload, const uint32_t numBytes)
+{
+    detach();
     if (_payloadLength)
     {
         free(_payload);
@@ -277,7 +467,7 @@ void NdefRecord::setPayload(const byte * payload, const int numBytes)
     _payloadLength = numBytes;
 }
 
-String NdefRecord::getId()
+String NdefRecord::getId() const
 {
     char id[_idLength + 1];
     memcpy(id, _id, _idLength);
@@ -285,13 +475,14 @@ String NdefRecord::getId()
     return String(id);
 }
 
-void NdefRecord::getId(byte *id)
+void NdefRecord::getId(byte *id) const
 {
     memcpy(id, _id, _idLength);
 }
 
 void NdefRecord::setId(const byte * id, const unsigned int numBytes)
 {
+    detach();
     if (_idLength)
     {
         free(_id);
@@ -302,51 +493,8 @@ void NdefRecord::setId(const byte * id, const unsigned int numBytes)
     _idLength = numBytes;
 }
 
-void NdefRecord::print()
-{
-    Serial.println(F("  NDEF Record"));
-    Serial.print(F("    TNF 0x"));Serial.print(_tnf, HEX);Serial.print(" ");
-    switch (_tnf) {
-    case TNF_EMPTY:
-        Serial.println(F("Empty"));
-        break;
-    case TNF_WELL_KNOWN:
-        Serial.println(F("Well Known"));
-        break;
-    case TNF_MIME_MEDIA:
-        Serial.println(F("Mime Media"));
-        break;
-    case TNF_ABSOLUTE_URI:
-        Serial.println(F("Absolute URI"));
-        break;
-    case TNF_EXTERNAL_TYPE:
-        Serial.println(F("External"));
-        break;
-    case TNF_UNKNOWN:
-        Serial.println(F("Unknown"));
-        break;
-    case TNF_UNCHANGED:
-        Serial.println(F("Unchanged"));
-        break;
-    case TNF_RESERVED:
-        Serial.println(F("Reserved"));
-        break;
-    default:
-        Serial.println();
-    }
-    Serial.print(F("    Type Length 0x"));Serial.print(_typeLength, HEX);Serial.print(" ");Serial.println(_typeLength);
-    Serial.print(F("    Payload Length 0x"));Serial.print(_payloadLength, HEX);;Serial.print(" ");Serial.println(_payloadLength);
-    if (_idLength)
-    {
-        Serial.print(F("    Id Length 0x"));Serial.println(_idLength, HEX);
-    }
-    Serial.print(F("    Type "));PrintHexChar(_type, _typeLength);
-    // TODO chunk large payloads so this is readable
-    Serial.print(F("    Payload "));PrintHexChar(_payload, _payloadLength);
-    if (_idLength)
-    {
-        Serial.print(F("    Id "));PrintHexChar(_id, _idLength);
-    }
-    Serial.print(F("    Record is "));Serial.print(getEncodedSize());Serial.println(" bytes");
-
+void NdefRecord::print() const
+{
+    NdefFormatter formatter(Serial);
+    formatter.format(*this);
 }
@@ -4,6 +4,7 @@
 #include <Due.h>
 #include <Arduino.h>
 #include <Ndef.h>
+#include <NdefSink.h>
 
 #define TNF_EMPTY 0x0
 #define TNF_WELL_KNOWN 0x01
@@ -19,36 +20,64 @@ class NdefRecord
     public:
         NdefRecord();
         NdefRecord(const NdefRecord& rhs);
+        // takes over the bytes of rhs, leaving it empty
+        NdefRecord(NdefRecord&& rhs);
         ~NdefRecord();
         NdefRecord& operator=(const NdefRecord& rhs);
+        NdefRecord& operator=(NdefRecord&& rhs);
 
-        int getEncodedSize();
-        void encode(byte *data, bool firstRecord, bool lastRecord);
+        uint32_t getEncodedSize() const;
+        // both return the number of bytes written, the sink version 0 if
+        // the sink refused them
+        uint32_t encode(byte *data, bool firstRecord, bool lastRecord) const;
+        uint32_t encode(NdefSink& sink, bool firstRecord, bool lastRecord) const;
 
-        unsigned int getTypeLength();
-        int getPayloadLength();
-        unsigned int getIdLength();
+        unsigned int getTypeLength() const;
+        uint32_t getPayloadLength() const;
+        unsigned int getIdLength() const;
 
-        byte getTnf();
-        void getType(byte *type);
-        void getPayload(byte *payload);
-        void getId(byte *id);
+        byte getTnf() const;
+        void getType(byte *type) const;
+        void getPayload(byte *payload) const;
+        void getId(byte *id) const;
+        // the payload in place, valid until the record changes
+        const byte *getPayload() const;
+        // the fields in place, valid until the record changes
+        NdefSpan getTypeSpan() const;
+        NdefSpan getIdSpan() const;
+        NdefSpan getPayloadSpan() const;
 
         // convenience methods
-        String getType();
-        String getId();
+        String getType() const;
+        String getId() const;
 
         void setTnf(byte tnf);
         void setType(const byte *type, const unsigned int numBytes);
-        void setPayload(const byte *payload, const int numBytes);
+        void setPayload(const byte *payload, const uint32_t numBytes);
         void setId(const byte *id, const unsigned int numBytes);
 
-        void print();
+        void print() const;
     private:
-        byte getTnfByte(bool firstRecord, bool lastRecord);
+        friend class NdefMessageBase;
+        // records in a NdefMessage borrow their bytes from the message arena
+        void borrow(byte *storage, byte tnf,
+                    const byte *type, unsigned int typeLength,
+                    const byte *id, unsigned int idLength,
+                    const byte *payload, uint32_t payloadLength);
+        void rebase(const byte *from, byte *to);
+        void detach();
+        void release();
+        void take(NdefRecord& rhs);
+        byte getTnfByte(bool firstRecord, bool lastRecord) const;
+        // tnf byte and lengths, at most 7 bytes; returns how many
+        unsigned int encodeHeader(byte *data, bool firstRecord, bool lastRecord) const;
+        bool _borrowed;
         byte _tnf; // 3 bit
+        // tnf and type hashed, kept up to date by NdefMessage for lookups
+        byte _typeHash;
         unsigned int _typeLength;
-        int _payloadLength;
+        // the full 32 bit length a long record can carry
+        uint32_t _payloadLength;
         unsigned int _idLength;
         byte *_type;
         byte *_payload;
@@ -0,0 +1,234 @@
+#include <NdefRecordTypes.h>
+#include <NdefUri.h>
+
+static const NdefSpan EMPTY_SPAN = { (const byte *)NULL, 0 };
+
+static bool isWellKnown(byte tnf, NdefSpan type, const char *name)
+{
+    return tnf == TNF_WELL_KNOWN && type.equals(name);
+}
+
+// the bytes of span from offset on
+static NdefSpan tail(NdefSpan span, unsigned int offset)
+{
+    NdefSpan rest = { span.data + offset, span.length - offset };
+    return rest;
+}
+
+NdefTextRecord::NdefTextRecord()
+{
+    parse(TNF_EMPTY, EMPTY_SPAN, EMPTY_SPAN);
+}
+
+NdefTextRecord::NdefTextRecord(const NdefRecord& record)
+{
+    parse(record.getTnf(), record.getTypeSpan(), record.getPayloadSpan());
+}
+
+NdefTextRecord::NdefTextRecord(const NdefRecordView& record)
+{
+    parse(record.getTnf(), record.getTypeSpan(), record.getPayloadSpan());
+}
+
+void NdefTextRecord::parse(byte tnf, NdefSpan type, NdefSpan payload)
+{
+    _valid = false;
+    _utf16 = false;
+    _language = EMPTY_SPAN;
+    _text = EMPTY_SPAN;
+
+    if (!isWellKnown(tnf, type, "T") || payload.length == 0)
+    {
+        return;
+    }
+
+    // status byte: bit 7 UTF-16, bits 5..0 the language length
+    byte status = payload.data[0];
+    unsigned int languageLength = status & 0x3F;
+    if (1 + languageLength > payload.length)
+    {
+        return;
+    }
+
+    _valid = true;
+    _utf16 = (status & 0x80) != 0;
+    _language.data = &payload.data[1];
+    _language.length = languageLength;
+    _text = tail(payload, 1 + languageLength);
+}
+
+bool NdefTextRecord::isValid() const
+{
+    return _valid;
+}
+
+bool NdefTextRecord::isUtf16() const
+{
+    return _utf16;
+}
+
+NdefSpan NdefTextRecord::getLanguage() const
+{
+    return _language;
+}
+
+NdefSpan NdefTextRecord::getText() const
+{
+    return _text;
+}
+
+NdefUriRecord::NdefUriRecord()
+{
+    parse(TNF_EMPTY, EMPTY_SPAN, EMPTY_SPAN);
+}
+
+NdefUriRecord::NdefUriRecord(const NdefRecord& record)
+{
+    parse(record.getTnf(), record.getTypeSpan(), record.getPayloadSpan());
+}
+
+NdefUriRecord::NdefUriRecord(const NdefRecordView& record)
+{
+    parse(record.getTnf(), record.getTypeSpan(), record.getPayloadSpan());
+}
+
+void NdefUriRecord::parse(byte tnf, NdefSpan type, NdefSpan payload)
+{
+    // at least the identifier code
+    _valid = isWellKnown(tnf, type, "U") && payload.length > 0;
+    _payload = _valid ? payload : EMPTY_SPAN;
+}
+
+bool NdefUriRecord::isValid() const
+{
+    return _valid;
+}
+
+byte NdefUriRecord::getPrefixCode() const
+{
+    return _valid ? _payload.data[0] : 0;
+}
+
+NdefSpan NdefUriRecord::getRemainder() const
+{
+    return _valid ? tail(_payload, 1) : EMPTY_SPAN;
+}
+
+unsigned int NdefUriRecord::getLength() const
+{
+    return NdefUriExpand(_payload, (char *)NULL, 0);
+}
+
+unsigned int NdefUriRecord::getUri(char *uri, unsigned int size) const
+{
+    return NdefUriExpand(_payload, uri, size);
+}
+
+NdefMimeRecord::NdefMimeRecord()
+{
+    parse(TNF_EMPTY, EMPTY_SPAN, EMPTY_SPAN);
+}
+
+NdefMimeRecord::NdefMimeRecord(const NdefRecord& record)
+{
+    parse(record.getTnf(), record.getTypeSpan(), record.getPayloadSpan());
+}
+
+NdefMimeRecord::NdefMimeRecord(const NdefRecordView& record)
+{
+    parse(record.getTnf(), record.getTypeSpan(), record.getPayloadSpan());
+}
+
+void NdefMimeRecord::parse(byte tnf, NdefSpan type, NdefSpan payload)
+{
+    _valid = tnf == TNF_MIME_MEDIA && type.length > 0;
+    _mimeType = _valid ? type : EMPTY_SPAN;
+    _data = _valid ? payload : EMPTY_SPAN;
+}
+
+bool NdefMimeRecord::isValid() const
+{
+    return _valid;
+}
+
+NdefSpan NdefMimeRecord::getMimeType() const
+{
+    return _mimeType;
+}
+
+NdefSpan NdefMimeRecord::getData() const
+{
+    return _data;
+}
+
+NdefSmartPoster::NdefSmartPoster()
+{
+    parse(TNF_EMPTY, EMPTY_SPAN, EMPTY_SPAN);
+}
+
+NdefSmartPoster::NdefSmartPoster(const NdefRecord& record)
+{
+    parse(record.getTnf(), record.getTypeSpan(), record.getPayloadSpan());
+}
+
+NdefSmartPoster::NdefSmartPoster(const NdefRecordView& record)
+{
+    parse(record.getTnf(), record.getTypeSpan(), record.getPayloadSpan());
+}
+
+// only the type is checked here, the nested records are read on demand
+void NdefSmartPoster::parse(byte tnf, NdefSpan type, NdefSpan payload)
+{
+    _valid = isWellKnown(tnf, type, "Sp");
+    _payload = _valid ? payload : EMPTY_SPAN;
+}
+
+bool NdefSmartPoster::isValid() const
+{
+    return _valid;
+}
+
+NdefMessageView NdefSmartPoster::getMessage() const
+{
+    return NdefMessageView(_payload.data, _payload.length);
+}
+
+NdefUriRecord NdefSmartPoster::getUri() const
+{
+    for (const NdefRecordView& record : getMessage())
+    {
+        NdefUriRecord uri(record);
+        if (uri.isValid())
+        {
+            return uri;
+        }
+    }
+    return NdefUriRecord();
+}
+
+NdefTextRecord NdefSmartPoster::getTitle() const
+{
+    return getTitle((const char *)NULL);
+}
+
+NdefTextRecord NdefSmartPoster::getTitle(const char *language) const
+{
+    NdefTextRecord first;
+    for (const NdefRecordView& record : getMessage())
+    {
+        NdefTextRecord title(record);
+        if (!title.isValid())
+        {
+            continue;
+        }
+        if (language == NULL || title.getLanguage().equals(language))
+        {
+            return title;
+        }
+        if (!first.isValid())
+        {
+            first = title;
+        }
+    }
+    return first;
+}
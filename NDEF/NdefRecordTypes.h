@@ -0,0 +1,103 @@
+#ifndef NdefRecordTypes_h
+#define NdefRecordTypes_h
+
+#include <Ndef.h>
+#include <NdefRecord.h>
+#include <NdefView.h>
+
+// Typed readers for common records. Each one parses the payload of a
+// NdefRecord or NdefRecordView in place: the spans it returns point into
+// that record's bytes and are only valid for as long as they are. A record
+// of another type, or one too short for its fields, reads as invalid with
+// empty spans.
+
+// well known type "T"
+class NdefTextRecord
+{
+    public:
+        NdefTextRecord();
+        NdefTextRecord(const NdefRecord& record);
+        NdefTextRecord(const NdefRecordView& record);
+
+        bool isValid() const;
+        // the text is UTF-16 rather than UTF-8
+        bool isUtf16() const;
+        // IANA language code such as "en-US"
+        NdefSpan getLanguage() const;
+        NdefSpan getText() const;
+    private:
+        void parse(byte tnf, NdefSpan type, NdefSpan payload);
+        bool _valid;
+        bool _utf16;
+        NdefSpan _language;
+        NdefSpan _text;
+};
+
+// well known type "U"
+class NdefUriRecord
+{
+    public:
+        NdefUriRecord();
+        NdefUriRecord(const NdefRecord& record);
+        NdefUriRecord(const NdefRecordView& record);
+
+        bool isValid() const;
+        // the identifier code for the prefix left out, see NdefUri.h
+        byte getPrefixCode() const;
+        // what follows the prefix
+        NdefSpan getRemainder() const;
+        // the whole URI, prefix included
+        unsigned int getLength() const;
+        // copy the whole URI to uri, NUL terminated and cut to fit size;
+        // returns getLength()
+        unsigned int getUri(char *uri, unsigned int size) const;
+    private:
+        void parse(byte tnf, NdefSpan type, NdefSpan payload);
+        bool _valid;
+        // code and remainder, as stored
+        NdefSpan _payload;
+};
+
+// a record of TNF_MIME_MEDIA
+class NdefMimeRecord
+{
+    public:
+        NdefMimeRecord();
+        NdefMimeRecord(const NdefRecord& record);
+        NdefMimeRecord(const NdefRecordView& record);
+
+        bool isValid() const;
+        // such as "text/plain"
+        NdefSpan getMimeType() const;
+        NdefSpan getData() const;
+    private:
+        void parse(byte tnf, NdefSpan type, NdefSpan payload);
+        bool _valid;
+        NdefSpan _mimeType;
+        NdefSpan _data;
+};
+
+// Well known type "Sp", a URI with a title and more wrapped in a message
+// of its own. Nothing in the nested message is read until it is asked for.
+class NdefSmartPoster
+{
+    public:
+        NdefSmartPoster();
+        NdefSmartPoster(const NdefRecord& record);
+        NdefSmartPoster(const NdefRecordView& record);
+
+        bool isValid() const;
+        // the nested message, read in place
+        NdefMessageView getMessage() const;
+        // the URI the poster points at, invalid if there is none
+        NdefUriRecord getUri() const;
+        // the first title, or the first in language if there is one
+        NdefTextRecord getTitle() const;
+        NdefTextRecord getTitle(const char *language) const;
+    private:
+        void parse(byte tnf, NdefSpan type, NdefSpan payload);
+        bool _valid;
+        NdefSpan _payload;
+};
+
+#endif
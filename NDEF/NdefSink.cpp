@@ -0,0 +1,92 @@
+#include <NdefSink.h>
+
+NdefBufferSink::NdefBufferSink(byte *buffer, unsigned int size)
+{
+    _buffer = buffer;
+    _size = size;
+    _length = 0;
+}
+
+boolean NdefBufferSink::write(const byte *data, unsigned int length)
+{
+    if (length > _size - _length)
+    {
+        return false;
+    }
+
+    if (length)
+    {
+        memcpy(&_buffer[_length], data, length);
+    }
+    _length += length;
+    return true;
+}
+
+unsigned int NdefBufferSink::getLength() const
+{
+    return _length;
+}
+
+NdefChunkedSink::NdefChunkedSink(byte *buffer, unsigned int size)
+{
+    _buffer = buffer;
+    _size = size;
+    _buffered = 0;
+    _offset = 0;
+}
+
+boolean NdefChunkedSink::write(const byte *data, unsigned int length)
+{
+    while (length)
+    {
+        if (_buffered == 0 && length >= _size)
+        {
+            // whole chunks go straight from the caller's bytes
+            if (!writeChunk(_offset, data, _size))
+            {
+                return false;
+            }
+            _offset += _size;
+            data += _size;
+            length -= _size;
+            continue;
+        }
+
+        unsigned int count = _size - _buffered;
+        if (count > length)
+        {
+            count = length;
+        }
+        memcpy(&_buffer[_buffered], data, count);
+        _buffered += count;
+        data += count;
+        length -= count;
+
+        if (_buffered == _size && !flush())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+boolean NdefChunkedSink::flush()
+{
+    if (_buffered == 0)
+    {
+        return true;
+    }
+
+    if (!writeChunk(_offset, _buffer, _buffered))
+    {
+        return false;
+    }
+    _offset += _buffered;
+    _buffered = 0;
+    return true;
+}
+
+unsigned long NdefChunkedSink::getBytesWritten() const
+{
+    return _offset + _buffered;
+}
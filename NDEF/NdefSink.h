@@ -0,0 +1,48 @@
+#ifndef NdefSink_h
+#define NdefSink_h
+
+#include <Ndef.h>
+
+// Where an encoder sends its bytes, in order, a piece at a time.
+class NdefSink
+{
+    public:
+        // false stops the encoder
+        virtual boolean write(const byte *data, unsigned int length) = 0;
+};
+
+// Writes into a caller's buffer, refusing anything that does not fit.
+class NdefBufferSink : public NdefSink
+{
+    public:
+        NdefBufferSink(byte *buffer, unsigned int size);
+        boolean write(const byte *data, unsigned int length);
+        unsigned int getLength() const;
+    private:
+        byte *_buffer;
+        unsigned int _size;
+        unsigned int _length;
+};
+
+// Collects bytes in a caller's buffer and passes them on a buffer at a
+// time, for drivers that write a tag in fixed size blocks. Pieces at
+// least a buffer long skip the copy.
+class NdefChunkedSink : public NdefSink
+{
+    public:
+        NdefChunkedSink(byte *buffer, unsigned int size);
+        boolean write(const byte *data, unsigned int length);
+        // pass on what is still buffered, call after the last write
+        boolean flush();
+        unsigned long getBytesWritten() const;
+    protected:
+        // the next length bytes of the output, offset bytes from its start
+        virtual boolean writeChunk(unsigned long offset, const byte *data, unsigned int length) = 0;
+    private:
+        byte *_buffer;
+        unsigned int _size;
+        unsigned int _buffered;
+        unsigned long _offset;
+};
+
+#endif
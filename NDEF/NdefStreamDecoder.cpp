@@ -0,0 +1,250 @@
+#include <NdefStreamDecoder.h>
+
+NdefStreamDecoder::NdefStreamDecoder(NdefMessageBase& message)
+{
+    _message = &message;
+    _sink = (NdefPayloadSink *)NULL;
+    reset();
+}
+
+NdefStreamDecoder::NdefStreamDecoder(NdefPayloadSink& sink)
+{
+    _message = (NdefMessageBase *)NULL;
+    _sink = &sink;
+    reset();
+}
+
+void NdefStreamDecoder::reset()
+{
+    _state = STATE_HEADER;
+    _status = NDEF_OK;
+    _bytesRead = 0;
+    _header = 0;
+    _typeLength = 0;
+    _idLength = 0;
+    _payloadLength = 0;
+    _remaining = 0;
+    _chunked = false;
+    _first = true;
+
+    if (_message)
+    {
+        _message->clear();
+    }
+}
+
+NdefStatus NdefStreamDecoder::write(const byte *data, unsigned int numBytes)
+{
+    while (numBytes && _state < STATE_DONE)
+    {
+        unsigned int count = 1;
+
+        switch (_state)
+        {
+            case STATE_HEADER:
+                _header = data[0];
+                _state = STATE_TYPE_LENGTH;
+                break;
+
+            case STATE_TYPE_LENGTH:
+                _typeLength = data[0];
+                _idLength = 0;
+                _payloadLength = 0;
+                // short records have a 1 byte payload length
+                _remaining = (_header & 0x10) ? 1 : 4;
+                _state = STATE_PAYLOAD_LENGTH;
+                break;
+
+            case STATE_PAYLOAD_LENGTH:
+                _payloadLength = (_payloadLength << 8) | data[0];
+                if (--_remaining == 0)
+                {
+                    if (_header & 0x8)
+                    {
+                        _state = STATE_ID_LENGTH;
+                    }
+                    else
+                    {
+                        startFields();
+                    }
+                }
+                break;
+
+            case STATE_ID_LENGTH:
+                _idLength = data[0];
+                startFields();
+                break;
+
+            case STATE_FIELDS:
+                count = _remaining < numBytes ? _remaining : numBytes;
+                memcpy(&_fields[_typeLength + _idLength - _remaining], data, count);
+                _remaining -= count;
+                if (_remaining == 0)
+                {
+                    startPayload();
+                }
+                break;
+
+            case STATE_PAYLOAD:
+                count = _remaining < numBytes ? _remaining : numBytes;
+                if (_sink)
+                {
+                    _sink->payload(data, count);
+                }
+                else if (!_message->appendPayload(data, count))
+                {
+                    fail(NDEF_ERROR_NO_MEMORY);
+                    break;
+                }
+                _remaining -= count;
+                if (_remaining == 0)
+                {
+                    endRecord();
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        data += count;
+        numBytes -= count;
+        _bytesRead += count;
+    }
+
+    return _status;
+}
+
+// the lengths are known, check them before any field is read
+void NdefStreamDecoder::startFields()
+{
+    NdefStatus status = NdefMessageBase::checkRecord(_header, _typeLength, _idLength,
+                                                 _payloadLength, _first, _chunked);
+    if (status != NDEF_OK)
+    {
+        fail(status);
+        return;
+    }
+
+    if (_typeLength + _idLength > sizeof(_fields))
+    {
+        fail(NDEF_ERROR_NO_MEMORY);
+        return;
+    }
+
+    _remaining = _typeLength + _idLength;
+    _state = STATE_FIELDS;
+    if (_remaining == 0)
+    {
+        startPayload();
+    }
+}
+
+void NdefStreamDecoder::startPayload()
+{
+    if (!_chunked)
+    {
+        byte tnf = _header & 0x7;
+        if (_sink)
+        {
+            _sink->beginRecord(tnf, _fields, _typeLength, &_fields[_typeLength], _idLength);
+        }
+        else if (!_message->emplaceRecord(tnf, _fields, _typeLength, NULL, 0,
+                                          &_fields[_typeLength], _idLength))
+        {
+            fail(NDEF_ERROR_NO_MEMORY);
+            return;
+        }
+    }
+
+    // room for the whole chunk up front, so pieces land without regrowing
+    if (_message && ((unsigned int)_payloadLength != _payloadLength ||
+                     !_message->growArena(_payloadLength)))
+    {
+        fail(NDEF_ERROR_NO_MEMORY);
+        return;
+    }
+
+    _remaining = _payloadLength;
+    _state = STATE_PAYLOAD;
+    if (_remaining == 0)
+    {
+        endRecord();
+    }
+}
+
+void NdefStreamDecoder::endRecord()
+{
+    _first = false;
+    _chunked = (_header & 0x20) != 0;
+
+    if (!_chunked && _sink)
+    {
+        _sink->endRecord();
+    }
+
+    if (_header & 0x40)
+    {
+        if (_chunked)
+        {
+            fail(NDEF_ERROR_CHUNK);
+            return;
+        }
+        if (_message)
+        {
+            NdefStatus status = _message->expandRecords();
+            if (status != NDEF_OK)
+            {
+                fail(status);
+                return;
+            }
+        }
+        _state = STATE_DONE;
+    }
+    else
+    {
+        _state = STATE_HEADER;
+    }
+}
+
+void NdefStreamDecoder::fail(NdefStatus status)
+{
+    _status = status;
+    _state = STATE_ERROR;
+
+    if (_message)
+    {
+        _message->clear();
+    }
+}
+
+NdefStatus NdefStreamDecoder::finish()
+{
+    if (_status == NDEF_OK && _state != STATE_DONE)
+    {
+        if (_bytesRead == 0)
+        {
+            _status = NDEF_ERROR_EMPTY;
+        }
+        else if (_state == STATE_HEADER)
+        {
+            _status = NDEF_ERROR_MESSAGE_END;
+        }
+        else
+        {
+            _status = NDEF_ERROR_TRUNCATED;
+        }
+        fail(_status);
+    }
+    return _status;
+}
+
+boolean NdefStreamDecoder::isComplete() const
+{
+    return _state == STATE_DONE;
+}
+
+unsigned long NdefStreamDecoder::getBytesRead() const
+{
+    return _bytesRead;
+}
@@ -0,0 +1,90 @@
+#ifndef NdefStreamDecoder_h
+#define NdefStreamDecoder_h
+
+#include <Ndef.h>
+#include <NdefMessage.h>
+
+// room for the type and id of one record while its header arrives
+#ifndef NDEF_STREAM_FIELD_BYTES
+#define NDEF_STREAM_FIELD_BYTES 64
+#endif
+
+// Receives the records of a message as NdefStreamDecoder reads them.
+// Chunked records arrive joined: one beginRecord, the payload of every
+// chunk in order, then one endRecord.
+class NdefPayloadSink
+{
+    public:
+        // type and id are only valid for the duration of the call
+        virtual void beginRecord(byte tnf,
+                                 const byte *type, unsigned int typeLength,
+                                 const byte *id, unsigned int idLength) = 0;
+        // the next piece of payload, as much as has arrived
+        virtual void payload(const byte *data, unsigned int length) = 0;
+        virtual void endRecord() = 0;
+};
+
+// Decodes an NDEF message from bytes that arrive a piece at a time, for
+// instance page by page from a tag. Each record is checked the same way
+// as NdefMessage::decode. Compressed records are expanded when building a
+// message; a NdefPayloadSink gets them as they are, see NdefDecompressor.
+class NdefStreamDecoder
+{
+    public:
+        // build the records in message, replacing what it held
+        NdefStreamDecoder(NdefMessageBase& message);
+        // pass the records to sink without keeping their payloads, so a
+        // record of any size is decoded in constant memory
+        NdefStreamDecoder(NdefPayloadSink& sink);
+
+        // start over on a new message
+        void reset();
+        // Feed the next numBytes of the message. Returns NDEF_OK until the
+        // input turns out to be malformed; the error then sticks until
+        // reset. Bytes after the end of the message are ignored.
+        NdefStatus write(const byte *data, unsigned int numBytes);
+        // call once the input is exhausted; NDEF_OK only if the message
+        // was complete. A message being built is emptied on error.
+        NdefStatus finish();
+
+        // the record with ME has been read
+        boolean isComplete() const;
+        unsigned long getBytesRead() const;
+    private:
+        enum State
+        {
+            STATE_HEADER,
+            STATE_TYPE_LENGTH,
+            STATE_PAYLOAD_LENGTH,
+            STATE_ID_LENGTH,
+            STATE_FIELDS,
+            STATE_PAYLOAD,
+            STATE_DONE,
+            STATE_ERROR
+        };
+
+        void startFields();
+        void startPayload();
+        void endRecord();
+        void fail(NdefStatus status);
+
+        NdefMessageBase *_message;
+        NdefPayloadSink *_sink;
+        State _state;
+        NdefStatus _status;
+        unsigned long _bytesRead;
+
+        byte _header;
+        unsigned int _typeLength;
+        unsigned int _idLength;
+        uint32_t _payloadLength;
+        // bytes still to come of the length, fields or payload
+        uint32_t _remaining;
+        // the previous record continues into this one
+        bool _chunked;
+        bool _first;
+        // type then id of the record being read
+        byte _fields[NDEF_STREAM_FIELD_BYTES];
+};
+
+#endif
@@ -0,0 +1,194 @@
+#include <NdefUri.h>
+
+// every prefix NUL terminated, in code order, from the NFC Forum URI RTD
+static const char URI_PREFIXES[] PROGMEM =
+    "\0"                            // 0x00
+    "http://www.\0"                 // 0x01
+    "https://www.\0"                // 0x02
+    "http://\0"                     // 0x03
+    "https://\0"                    // 0x04
+    "tel:\0"                        // 0x05
+    "mailto:\0"                     // 0x06
+    "ftp://anonymous:anonymous@\0"  // 0x07
+    "ftp://ftp.\0"                  // 0x08
+    "ftps://\0"                     // 0x09
+    "sftp://\0"                     // 0x0A
+    "smb://\0"                      // 0x0B
+    "nfs://\0"                      // 0x0C
+    "ftp://\0"                      // 0x0D
+    "dav://\0"                      // 0x0E
+    "news:\0"                       // 0x0F
+    "telnet://\0"                   // 0x10
+    "imap:\0"                       // 0x11
+    "rtsp://\0"                     // 0x12
+    "urn:\0"                        // 0x13
+    "pop:\0"                        // 0x14
+    "sip:\0"                        // 0x15
+    "sips:\0"                       // 0x16
+    "tftp://\0"                     // 0x17
+    "btspp://\0"                    // 0x18
+    "btl2cap://\0"                  // 0x19
+    "btgoep://\0"                   // 0x1A
+    "tcpobex://\0"                  // 0x1B
+    "irdaobex://\0"                 // 0x1C
+    "file://\0"                     // 0x1D
+    "urn:epc:id:\0"                 // 0x1E
+    "urn:epc:tag:\0"                // 0x1F
+    "urn:epc:pat:\0"                // 0x20
+    "urn:epc:raw:\0"                // 0x21
+    "urn:epc:\0"                    // 0x22
+    "urn:nfc:";                     // 0x23
+
+// where each code's prefix starts in URI_PREFIXES
+static const uint16_t URI_PREFIX_OFFSETS[NDEF_URI_PREFIX_COUNT + 1] PROGMEM = {
+    0, 1, 13, 26, 34, 43, 48, 56, 83, 94, 102, 110, 117, 124, 131, 138, 144, 154,
+    160, 168, 173, 178, 183, 189, 197, 206, 217, 227, 238, 250, 258, 270, 283, 296,
+    309, 318, 327
+};
+
+// the only codes worth trying for each first character
+static const byte URI_CANDIDATES_B[] PROGMEM = { 0x18, 0x19, 0x1A, 0 };
+static const byte URI_CANDIDATES_D[] PROGMEM = { 0x0E, 0 };
+static const byte URI_CANDIDATES_F[] PROGMEM = { 0x07, 0x08, 0x0D, 0x09, 0x1D, 0 };
+static const byte URI_CANDIDATES_H[] PROGMEM = { 0x01, 0x02, 0x03, 0x04, 0 };
+static const byte URI_CANDIDATES_I[] PROGMEM = { 0x11, 0x1C, 0 };
+static const byte URI_CANDIDATES_M[] PROGMEM = { 0x06, 0 };
+static const byte URI_CANDIDATES_N[] PROGMEM = { 0x0C, 0x0F, 0 };
+static const byte URI_CANDIDATES_P[] PROGMEM = { 0x14, 0 };
+static const byte URI_CANDIDATES_R[] PROGMEM = { 0x12, 0 };
+static const byte URI_CANDIDATES_S[] PROGMEM = { 0x0A, 0x0B, 0x15, 0x16, 0 };
+static const byte URI_CANDIDATES_T[] PROGMEM = { 0x05, 0x10, 0x17, 0x1B, 0 };
+static const byte URI_CANDIDATES_U[] PROGMEM = { 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x13, 0 };
+
+static const byte *uriCandidates(byte first)
+{
+    switch (first)
+    {
+        case 'b': return URI_CANDIDATES_B;
+        case 'd': return URI_CANDIDATES_D;
+        case 'f': return URI_CANDIDATES_F;
+        case 'h': return URI_CANDIDATES_H;
+        case 'i': return URI_CANDIDATES_I;
+        case 'm': return URI_CANDIDATES_M;
+        case 'n': return URI_CANDIDATES_N;
+        case 'p': return URI_CANDIDATES_P;
+        case 'r': return URI_CANDIDATES_R;
+        case 's': return URI_CANDIDATES_S;
+        case 't': return URI_CANDIDATES_T;
+        case 'u': return URI_CANDIDATES_U;
+        default: return (const byte *)NULL;
+    }
+}
+
+static const char *uriPrefix(byte code)
+{
+    return &URI_PREFIXES[pgm_read_word(&URI_PREFIX_OFFSETS[code])];
+}
+
+unsigned int NdefUriPrefixLength(byte code)
+{
+    if (code == 0 || code >= NDEF_URI_PREFIX_COUNT)
+    {
+        return 0;
+    }
+    // the next prefix starts after this one's NUL
+    return pgm_read_word(&URI_PREFIX_OFFSETS[code + 1]) -
+           pgm_read_word(&URI_PREFIX_OFFSETS[code]) - 1;
+}
+
+static bool uriStartsWith(const byte *uri, unsigned int length, byte code)
+{
+    unsigned int prefixLength = NdefUriPrefixLength(code);
+    if (prefixLength > length)
+    {
+        return false;
+    }
+
+    const char *prefix = uriPrefix(code);
+    for (unsigned int i = 0; i < prefixLength; i++)
+    {
+        if ((byte)pgm_read_byte(&prefix[i]) != uri[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+byte NdefUriAbbreviate(const byte *uri, unsigned int length)
+{
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    const byte *candidates = uriCandidates(uri[0]);
+    if (!candidates)
+    {
+        return 0;
+    }
+
+    // "https://www.example.com" starts with both 0x04 and 0x02, keep the longest
+    byte best = 0;
+    for (byte code; (code = pgm_read_byte(candidates)) != 0; candidates++)
+    {
+        if (NdefUriPrefixLength(code) > NdefUriPrefixLength(best) &&
+            uriStartsWith(uri, length, code))
+        {
+            best = code;
+        }
+    }
+    return best;
+}
+
+unsigned int NdefUriExpand(NdefSpan payload, char *uri, unsigned int size)
+{
+    if (payload.length == 0)
+    {
+        if (size)
+        {
+            uri[0] = '\0';
+        }
+        return 0;
+    }
+
+    byte code = payload.data[0] < NDEF_URI_PREFIX_COUNT ? payload.data[0] : 0;
+    unsigned int prefixLength = NdefUriPrefixLength(code);
+    unsigned int restLength = payload.length - 1;
+    unsigned int written = 0;
+
+    if (size)
+    {
+        const char *prefix = uriPrefix(code);
+        for (unsigned int i = 0; i < prefixLength && written < size - 1; i++)
+        {
+            uri[written++] = pgm_read_byte(&prefix[i]);
+        }
+        unsigned int count = restLength < size - 1 - written ? restLength : size - 1 - written;
+        memcpy(&uri[written], &payload.data[1], count);
+        written += count;
+        uri[written] = '\0';
+    }
+
+    return prefixLength + restLength;
+}
+
+uint32_t NdefUriBytesSaved(const NdefMessageBase& message)
+{
+    uint32_t saved = 0;
+    for (unsigned int i = 0; i < message.getRecordCount(); i++)
+    {
+        const NdefRecord& record = message[i];
+        byte type[1];
+        if (record.getTnf() == TNF_WELL_KNOWN && record.getTypeLength() == 1 &&
+            record.getPayloadLength() > 0)
+        {
+            record.getType(type);
+            if (type[0] == 0x55)
+            {
+                saved += NdefUriPrefixLength(record.getPayload()[0]);
+            }
+        }
+    }
+    return saved;
+}
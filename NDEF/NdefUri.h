@@ -0,0 +1,25 @@
+#ifndef NdefUri_h
+#define NdefUri_h
+
+#include <Ndef.h>
+#include <NdefMessage.h>
+
+// URI records start with an identifier code standing for one of these
+// prefixes, so "https://www." costs one byte on the tag instead of twelve.
+// Codes past the last are reserved and read as no prefix.
+#define NDEF_URI_PREFIX_COUNT 0x24
+
+// the code of the longest standard prefix uri starts with, 0 if none
+byte NdefUriAbbreviate(const byte *uri, unsigned int length);
+// characters the prefix for code stands for
+unsigned int NdefUriPrefixLength(byte code);
+
+// Write the URI in a URI record payload to uri with its prefix spelled
+// out, NUL terminated and cut to fit size. Returns the length of the
+// whole URI, so a size of 0 asks how big uri has to be.
+unsigned int NdefUriExpand(NdefSpan payload, char *uri, unsigned int size);
+
+// bytes the URI records of message save by abbreviating their prefixes
+uint32_t NdefUriBytesSaved(const NdefMessageBase& message);
+
+#endif
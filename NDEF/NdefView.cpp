@@ -0,0 +1,270 @@
+#include <NdefView.h>
+
+NdefRecordView::NdefRecordView()
+{
+    _header = (const byte *)NULL;
+    _type = (const byte *)NULL;
+    _id = (const byte *)NULL;
+    _payload = (const byte *)NULL;
+    _typeLength = 0;
+    _idLength = 0;
+    _payloadLength = 0;
+    _encodedSize = 0;
+}
+
+NdefRecordView::NdefRecordView(const byte *data, unsigned int numBytes)
+{
+    *this = NdefRecordView();
+
+    // tnf byte and type length
+    if (data == NULL || numBytes < 2)
+    {
+        return;
+    }
+
+    byte tnf_byte = data[0];
+    bool sr = (tnf_byte & 0x10) != 0;
+    bool il = (tnf_byte & 0x8) != 0;
+
+    unsigned int index = 1;
+    unsigned int typeLength = data[index++];
+
+    uint32_t payloadLength;
+    if (sr)
+    {
+        if (index + 1 > numBytes) return;
+        payloadLength = data[index++];
+    }
+    else
+    {
+        if (index + 4 > numBytes) return;
+        payloadLength = ((uint32_t)data[index] << 24)
+            | ((uint32_t)data[index + 1] << 16)
+            | ((uint32_t)data[index + 2] << 8)
+            | (uint32_t)data[index + 3];
+        index += 4;
+    }
+
+    unsigned int idLength = 0;
+    if (il)
+    {
+        if (index + 1 > numBytes) return;
+        idLength = data[index++];
+    }
+
+    // compare the payload length with what is left rather than adding it
+    // up, a 32 bit length near the top of the range would wrap
+    unsigned long size = (unsigned long)index + typeLength + idLength;
+    if (size > numBytes || payloadLength > numBytes - size)
+    {
+        return;
+    }
+    size += payloadLength;
+
+    _header = data;
+    _type = &data[index];
+    _typeLength = typeLength;
+    index += typeLength;
+    _id = &data[index];
+    _idLength = idLength;
+    index += idLength;
+    _payload = &data[index];
+    _payloadLength = payloadLength;
+    _encodedSize = size;
+}
+
+bool NdefRecordView::isValid() const
+{
+    return _header != NULL;
+}
+
+byte NdefRecordView::getTnf() const
+{
+    return _header ? (_header[0] & 0x7) : TNF_EMPTY;
+}
+
+bool NdefRecordView::isLastRecord() const
+{
+    return _header ? (_header[0] & 0x40) != 0 : true;
+}
+
+bool NdefRecordView::getFlag(byte mask) const
+{
+    return _header && (_header[0] & mask) != 0;
+}
+
+bool NdefRecordView::isMessageBegin() const
+{
+    return getFlag(0x80);
+}
+
+bool NdefRecordView::isMessageEnd() const
+{
+    return getFlag(0x40);
+}
+
+bool NdefRecordView::isChunked() const
+{
+    return getFlag(0x20);
+}
+
+bool NdefRecordView::isShortRecord() const
+{
+    return getFlag(0x10);
+}
+
+bool NdefRecordView::hasId() const
+{
+    return getFlag(0x8);
+}
+
+const byte *NdefRecordView::getType() const
+{
+    return _type;
+}
+
+unsigned int NdefRecordView::getTypeLength() const
+{
+    return _typeLength;
+}
+
+const byte *NdefRecordView::getId() const
+{
+    return _id;
+}
+
+unsigned int NdefRecordView::getIdLength() const
+{
+    return _idLength;
+}
+
+const byte *NdefRecordView::getPayload() const
+{
+    return _payload;
+}
+
+unsigned int NdefRecordView::getPayloadLength() const
+{
+    return _payloadLength;
+}
+
+NdefSpan NdefRecordView::getTypeSpan() const
+{
+    NdefSpan span = { _type, _typeLength };
+    return span;
+}
+
+NdefSpan NdefRecordView::getIdSpan() const
+{
+    NdefSpan span = { _id, _idLength };
+    return span;
+}
+
+NdefSpan NdefRecordView::getPayloadSpan() const
+{
+    NdefSpan span = { _payload, _payloadLength };
+    return span;
+}
+
+unsigned int NdefRecordView::getEncodedSize() const
+{
+    return _encodedSize;
+}
+
+NdefMessageView::iterator::iterator(const byte *data, unsigned int numBytes)
+    : _data(data), _remaining(numBytes), _record(data, numBytes)
+{
+    if (!_record.isValid())
+    {
+        _data = (const byte *)NULL;
+        _remaining = 0;
+    }
+}
+
+const NdefRecordView& NdefMessageView::iterator::operator*() const
+{
+    return _record;
+}
+
+const NdefRecordView* NdefMessageView::iterator::operator->() const
+{
+    return &_record;
+}
+
+NdefMessageView::iterator& NdefMessageView::iterator::operator++()
+{
+    if (_data == NULL || _record.isLastRecord())
+    {
+        *this = iterator((const byte *)NULL, 0);
+    }
+    else
+    {
+        unsigned int size = _record.getEncodedSize();
+        *this = iterator(_data + size, _remaining - size);
+    }
+    return *this;
+}
+
+bool NdefMessageView::iterator::operator!=(const iterator& rhs) const
+{
+    return _data != rhs._data;
+}
+
+bool NdefMessageView::iterator::operator==(const iterator& rhs) const
+{
+    return _data == rhs._data;
+}
+
+NdefMessageView::NdefMessageView()
+{
+    _data = (const byte *)NULL;
+    _numBytes = 0;
+}
+
+NdefMessageView::NdefMessageView(const byte *data, unsigned int numBytes)
+{
+    _data = data;
+    _numBytes = numBytes;
+}
+
+NdefMessageView::iterator NdefMessageView::begin() const
+{
+    return iterator(_data, _numBytes);
+}
+
+NdefMessageView::iterator NdefMessageView::end() const
+{
+    return iterator((const byte *)NULL, 0);
+}
+
+const byte *NdefMessageView::getData() const
+{
+    return _data;
+}
+
+unsigned int NdefMessageView::getEncodedSize() const
+{
+    return _numBytes;
+}
+
+unsigned int NdefMessageView::getRecordCount() const
+{
+    unsigned int count = 0;
+    for (iterator it = begin(); it != end(); ++it)
+    {
+        count++;
+    }
+    return count;
+}
+
+NdefRecordView NdefMessageView::getRecord(unsigned int index) const
+{
+    for (iterator it = begin(); it != end(); ++it)
+    {
+        if (index-- == 0)
+        {
+            return *it;
+        }
+    }
+    return NdefRecordView();
+}
@@ -0,0 +1,90 @@
+#ifndef NdefView_h
+#define NdefView_h
+
+#include <Ndef.h>
+#include <NdefRecord.h>
+
+// Non-owning views over an encoded NDEF message.
+// Nothing is copied or allocated, the views point straight into the caller's
+// buffer and are only valid for as long as that buffer is.
+
+class NdefRecordView
+{
+    public:
+        NdefRecordView();
+        // data points at the record header, numBytes is what is left of the message
+        NdefRecordView(const byte *data, unsigned int numBytes);
+
+        // false if the header or lengths run past the end of the buffer
+        bool isValid() const;
+
+        byte getTnf() const;
+        bool isLastRecord() const;
+
+        // header flags
+        bool isMessageBegin() const;
+        bool isMessageEnd() const;
+        bool isChunked() const;
+        bool isShortRecord() const;
+        bool hasId() const;
+
+        const byte *getType() const;
+        unsigned int getTypeLength() const;
+        const byte *getId() const;
+        unsigned int getIdLength() const;
+        const byte *getPayload() const;
+        unsigned int getPayloadLength() const;
+
+        NdefSpan getTypeSpan() const;
+        NdefSpan getIdSpan() const;
+        NdefSpan getPayloadSpan() const;
+
+        // bytes from the header to the end of the payload
+        unsigned int getEncodedSize() const;
+    private:
+        bool getFlag(byte mask) const;
+        const byte *_header;
+        const byte *_type;
+        const byte *_id;
+        const byte *_payload;
+        unsigned int _typeLength;
+        unsigned int _idLength;
+        unsigned int _payloadLength;
+        unsigned int _encodedSize;
+};
+
+class NdefMessageView
+{
+    public:
+        class iterator
+        {
+            public:
+                iterator(const byte *data, unsigned int numBytes);
+                const NdefRecordView& operator*() const;
+                const NdefRecordView* operator->() const;
+                iterator& operator++();
+                bool operator!=(const iterator& rhs) const;
+                bool operator==(const iterator& rhs) const;
+            private:
+                const byte *_data;
+                unsigned int _remaining;
+                NdefRecordView _record;
+        };
+
+        NdefMessageView();
+        NdefMessageView(const byte *data, unsigned int numBytes);
+
+        iterator begin() const;
+        iterator end() const;
+
+        const byte *getData() const;
+        unsigned int getEncodedSize() const;
+        unsigned int getRecordCount() const;
+        // an invalid view if index is out of range
+        NdefRecordView getRecord(unsigned int index) const;
+    private:
+        const byte *_data;
+        unsigned int _numBytes;
+};
+
+#endif
@@ -135,7 +135,7 @@ NfcTag NfcAdapter::read()
 
 }
 
-boolean NfcAdapter::write(NdefMessage& ndefMessage)
+boolean NfcAdapter::write(NdefMessageBase& ndefMessage)
 {
     boolean success;
     uint8_t type = guessTagType();
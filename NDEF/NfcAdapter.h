@@ -28,7 +28,7 @@ class NfcAdapter {
         void begin(boolean verbose=true);
         boolean tagPresent(unsigned long timeout=0); // tagAvailable
         NfcTag read();
-        boolean write(NdefMessage& ndefMessage);
+        boolean write(NdefMessageBase& ndefMessage);
         // erase tag by writing an empty NDEF record
         boolean erase();
         // format a tag as NDEF
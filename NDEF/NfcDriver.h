@@ -3,7 +3,7 @@ class NfcDriver
 {
     public:
         virtual NfcTag read(uint8_t * uid, int uidLength) = 0;
-        virtual boolean write(NdefMessage& message, uint8_t * uid, int uidLength) = 0;
+        virtual boolean write(NdefMessageBase& message, uint8_t * uid, int uidLength) = 0;
         // erase()
         // format()
 }
\ No newline at end of file
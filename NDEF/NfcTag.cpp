@@ -24,7 +24,7 @@ NfcTag::NfcTag(byte *uid, unsigned int  uidLength, String tagType)
     _ndefMessage = (NdefMessage*)NULL;
 }
 
-NfcTag::NfcTag(byte *uid, unsigned int  uidLength, String tagType, NdefMessage& ndefMessage)
+NfcTag::NfcTag(byte *uid, unsigned int  uidLength, String tagType, const NdefMessageBase& ndefMessage)
 {
     _uid = uid;
     _uidLength = uidLength;
@@ -32,6 +32,14 @@ NfcTag::NfcTag(byte *uid, unsigned int  uidLength, String tagType, NdefMessage&
     _ndefMessage = new NdefMessage(ndefMessage);
 }
 
+NfcTag::NfcTag(byte *uid, unsigned int  uidLength, String tagType, NdefMessageBase&& ndefMessage)
+{
+    _uid = uid;
+    _uidLength = uidLength;
+    _tagType = tagType;
+    _ndefMessage = new NdefMessage(static_cast<NdefMessageBase&&>(ndefMessage));
+}
+
 // I don't like this version, but it will use less memory
 NfcTag::NfcTag(byte *uid, unsigned int uidLength, String tagType, const byte *ndefData, const int ndefDataLength)
 {
@@ -41,6 +49,27 @@ NfcTag::NfcTag(byte *uid, unsigned int uidLength, String tagType, const byte *nd
     _ndefMessage = new NdefMessage(ndefData, ndefDataLength);
 }
 
+NfcTag::NfcTag(const NfcTag& rhs)
+{
+    _uid = rhs._uid;
+    _uidLength = rhs._uidLength;
+    _tagType = rhs._tagType;
+    _ndefMessage = (NdefMessage*)NULL;
+    if (rhs._ndefMessage)
+    {
+        _ndefMessage = new NdefMessage(*rhs._ndefMessage);
+    }
+}
+
+NfcTag::NfcTag(NfcTag&& rhs)
+{
+    _uid = rhs._uid;
+    _uidLength = rhs._uidLength;
+    _tagType = rhs._tagType;
+    _ndefMessage = rhs._ndefMessage;
+    rhs._ndefMessage = (NdefMessage*)NULL;
+}
+
 NfcTag::~NfcTag()
 {
     delete _ndefMessage;
@@ -54,23 +83,41 @@ NfcTag& NfcTag::operator=(const NfcTag& rhs)
         _uid = rhs._uid;
         _uidLength = rhs._uidLength;
         _tagType = rhs._tagType;
-        // TODO do I need a copy here?
+        // each tag owns its message
+        _ndefMessage = (NdefMessage*)NULL;
+        if (rhs._ndefMessage)
+        {
+            _ndefMessage = new NdefMessage(*rhs._ndefMessage);
+        }
+    }
+    return *this;
+}
+
+NfcTag& NfcTag::operator=(NfcTag&& rhs)
+{
+    if (this != &rhs)
+    {
+        delete _ndefMessage;
+        _uid = rhs._uid;
+        _uidLength = rhs._uidLength;
+        _tagType = rhs._tagType;
         _ndefMessage = rhs._ndefMessage;
+        rhs._ndefMessage = (NdefMessage*)NULL;
     }
     return *this;
 }
 
-uint8_t NfcTag::getUidLength()
+uint8_t NfcTag::getUidLength() const
 {
     return _uidLength;
 }
 
-void NfcTag::getUid(byte *uid, unsigned int uidLength)
+void NfcTag::getUid(byte *uid, unsigned int uidLength) const
 {
     memcpy(uid, _uid, _uidLength < uidLength ? _uidLength : uidLength);
 }
 
-String NfcTag::getUidString()
+String NfcTag::getUidString() const
 {
     String uidString = "";
     for (int i = 0; i < _uidLength; i++)
@@ -91,22 +138,28 @@ String NfcTag::getUidString()
     return uidString;
 }
 
-String NfcTag::getTagType()
+String NfcTag::getTagType() const
 {
     return _tagType;
 }
 
-boolean NfcTag::hasNdefMessage()
+boolean NfcTag::hasNdefMessage() const
 {
     return (_ndefMessage != NULL);
 }
 
-NdefMessage NfcTag::getNdefMessage()
+const NdefMessage& NfcTag::getNdefMessage() const
 {
+    static const NdefMessage empty;
+
+    if (_ndefMessage == NULL)
+    {
+        return empty;
+    }
     return *_ndefMessage;
 }
 
-void NfcTag::print()
+void NfcTag::print() const
 {
     Serial.print(F("NFC Tag - "));Serial.println(_tagType);
     Serial.print(F("UID "));Serial.println(getUidString());
@@ -11,17 +11,22 @@ class NfcTag
         NfcTag();
         NfcTag(byte *uid, unsigned int uidLength);
         NfcTag(byte *uid, unsigned int uidLength, String tagType);
-        NfcTag(byte *uid, unsigned int uidLength, String tagType, NdefMessage& ndefMessage);
+        NfcTag(byte *uid, unsigned int uidLength, String tagType, const NdefMessageBase& ndefMessage);
+        NfcTag(byte *uid, unsigned int uidLength, String tagType, NdefMessageBase&& ndefMessage);
         NfcTag(byte *uid, unsigned int uidLength, String tagType, const byte *ndefData, const int ndefDataLength);
+        NfcTag(const NfcTag& rhs);
+        NfcTag(NfcTag&& rhs);
         ~NfcTag(void);
         NfcTag& operator=(const NfcTag& rhs);
-        uint8_t getUidLength();
-        void getUid(byte *uid, unsigned int uidLength);
-        String getUidString();
-        String getTagType();
-        boolean hasNdefMessage();
-        NdefMessage getNdefMessage();
-        void print();
+        NfcTag& operator=(NfcTag&& rhs);
+        uint8_t getUidLength() const;
+        void getUid(byte *uid, unsigned int uidLength) const;
+        String getUidString() const;
+        String getTagType() const;
+        boolean hasNdefMessage() const;
+        // an empty message if there is none; valid as long as the tag is
+        const NdefMessage& getNdefMessage() const;
+        void print() const;
     private:
         byte *_uid;
         unsigned int _uidLength;
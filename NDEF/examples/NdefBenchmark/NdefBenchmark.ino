@@ -0,0 +1,307 @@
+/*  Example: NdefBenchmark
+ *
+ *  Times the NDEF library on a few typical messages and prints the results.
+ *  Needs no NFC shield. The unit tests in tests/ only check behaviour; the
+ *  numbers live here.
+ */
+//==============================================================================
+#include <Wire.h>
+#include <PN532.h>
+#include <NdefMessage.h>
+#include <NdefView.h>
+#include <NdefUri.h>
+#include <NdefCompression.h>
+#include <NdefFormatter.h>
+//==============================================================================
+#define DECODE_ROUNDS 200
+#define URI_ROUNDS 1000
+#define FIND_ROUNDS 200
+#define CODEC_ROUNDS 100
+#define FORMAT_ROUNDS 50
+//==============================================================================
+// text "en" "foo", uri "arduino.cc", mime "text/plain" with id "a"
+uint8_t mixed[] = {
+  0x91, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F,
+  0x11, 0x01, 0x0B, 0x55, 0x00, 0x61, 0x72, 0x64, 0x75, 0x69, 0x6E, 0x6F, 0x2E, 0x63, 0x63,
+  0x5A, 0x0A, 0x02, 0x01, 0x74, 0x65, 0x78, 0x74, 0x2F, 0x70, 0x6C, 0x61, 0x69, 0x6E, 0x61, 0x68, 0x69
+};
+
+const char config[] =
+  "{\"device\":{\"name\":\"sensor-17\",\"room\":\"lab\",\"interval\":60},"
+  "\"wifi\":{\"ssid\":\"workshop\",\"channel\":6,\"retries\":3},"
+  "\"sensors\":[{\"type\":\"temperature\",\"pin\":2,\"unit\":\"C\",\"enabled\":true},"
+  "{\"type\":\"humidity\",\"pin\":3,\"unit\":\"%\",\"enabled\":true},"
+  "{\"type\":\"pressure\",\"pin\":4,\"unit\":\"hPa\",\"enabled\":false},"
+  "{\"type\":\"light\",\"pin\":5,\"unit\":\"lx\",\"enabled\":true}]}";
+
+// results are added up here so the loops are not optimised away
+volatile unsigned long sink = 0;
+//==============================================================================
+void printRate(const __FlashStringHelper *name, unsigned long bytes, unsigned int rounds,
+               unsigned long elapsed)
+{
+  Serial.print(name);Serial.print(elapsed);Serial.print(F(" us for "));
+  Serial.print(rounds);Serial.print(F(" rounds, "));
+  // bytes per ms is kB/s
+  Serial.print(elapsed ? bytes * rounds * 1000 / elapsed : 0);
+  Serial.println(F(" kB/s"));
+}
+//==============================================================================
+// NdefMessageView against decoding into a NdefMessage
+void benchmarkView()
+{
+  unsigned long start = micros();
+  for (int i = 0; i < DECODE_ROUNDS; i++)
+  {
+    NdefMessage message = NdefMessage(mixed, sizeof(mixed));
+    sink += message.getRecord(2).getPayloadLength();
+  }
+  unsigned long messageTime = micros() - start;
+
+  start = micros();
+  for (int i = 0; i < DECODE_ROUNDS; i++)
+  {
+    for (const NdefRecordView& record : NdefMessageView(mixed, sizeof(mixed)))
+    {
+      sink += record.getPayloadLength();
+    }
+  }
+  unsigned long viewTime = micros() - start;
+
+  printRate(F("NdefMessage     "), sizeof(mixed), DECODE_ROUNDS, messageTime);
+  printRate(F("NdefMessageView "), sizeof(mixed), DECODE_ROUNDS, viewTime);
+}
+//==============================================================================
+// decode throughput for a valid message and for one rejected at its last record
+void benchmarkDecode()
+{
+  NdefMessage source = NdefMessage();
+  for (int i = 0; i < 4; i++)
+  {
+    source.addTextRecord("The quick brown fox jumps over the lazy dog");
+  }
+  unsigned int size = source.getEncodedSize();
+  uint8_t encoded[size];
+  source.encode(encoded);
+
+  NdefMessage m = NdefMessage();
+  unsigned long start = micros();
+  for (int i = 0; i < DECODE_ROUNDS; i++)
+  {
+    if (m.decode(encoded, size) == NDEF_OK)
+    {
+      sink += m.getRecordCount();
+    }
+  }
+  unsigned long validTime = micros() - start;
+
+  start = micros();
+  for (int i = 0; i < DECODE_ROUNDS; i++)
+  {
+    sink += m.decode(encoded, size - 1);
+  }
+  unsigned long truncatedTime = micros() - start;
+
+  printRate(F("decode valid     "), size, DECODE_ROUNDS, validTime);
+  printRate(F("decode truncated "), size, DECODE_ROUNDS, truncatedTime);
+}
+//==============================================================================
+// finding the longest URI prefix, for a long match, a rare one and none
+void benchmarkUriPrefix()
+{
+  const char *uris[] = { "https://www.arduino.cc/", "urn:epc:raw:1234", "arduino.cc" };
+  unsigned long start = micros();
+  for (int i = 0; i < URI_ROUNDS; i++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      sink += NdefUriAbbreviate((const byte *)uris[j], strlen(uris[j]));
+    }
+  }
+  unsigned long elapsed = micros() - start;
+
+  Serial.print(F("URI prefix       "));Serial.print(elapsed);Serial.print(F(" us for "));
+  Serial.print(URI_ROUNDS * 3);Serial.println(F(" lookups"));
+}
+//==============================================================================
+// the way sketches had to look a type up before findRecord
+int scanWithStrings(const NdefMessage& m, const char *type)
+{
+  for (unsigned int i = 0; i < m.getRecordCount(); i++)
+  {
+    NdefRecord record = m.getRecord(i);
+    if (record.getTnf() == TNF_MIME_MEDIA && record.getType().equals(type))
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// time to find the last of 1 to 64 records with same length types, by
+// String compare and by findRecord
+void benchmarkFind()
+{
+  const byte payload[] = { 0x01, 0x02 };
+  // 64 records take well over the 2 kB of an Uno
+#if defined(__AVR__)
+  const int sizes[] = { 1, 4, 16 };
+#else
+  const int sizes[] = { 1, 4, 16, 64 };
+#endif
+  for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+  {
+    int count = sizes[s];
+    char type[] = "application/vnd.x00";
+    NdefMessage m = NdefMessage();
+    for (int i = 0; i < count; i++)
+    {
+      type[17] = '0' + i / 10;
+      type[18] = '0' + i % 10;
+      m.addMimeMediaRecord(type, payload, sizeof(payload));
+    }
+
+    unsigned long start = micros();
+    for (int i = 0; i < FIND_ROUNDS; i++)
+    {
+      sink += scanWithStrings(m, type);
+    }
+    unsigned long stringTime = micros() - start;
+
+    // includes hashing every record once
+    start = micros();
+    for (int i = 0; i < FIND_ROUNDS; i++)
+    {
+      sink += m.findRecordIndex(TNF_MIME_MEDIA, (const byte *)type, 19);
+    }
+    unsigned long findTime = micros() - start;
+
+    Serial.print(count);Serial.print(F(" records: "));
+    Serial.print(stringTime);Serial.print(F(" us by String, "));
+    Serial.print(findTime);Serial.print(F(" us by findRecord for "));
+    Serial.print(FIND_ROUNDS);Serial.println(F(" lookups"));
+  }
+}
+//==============================================================================
+// what compression saves on a JSON config and what it costs, to weigh
+// against the time a tag takes per page or block
+void benchmarkCompression()
+{
+  NdefRecord record = NdefRecord();
+  const byte type[] = "application/json";
+  const byte id[] = { 'c' };
+  record.setTnf(TNF_MIME_MEDIA);
+  record.setType(type, sizeof(type) - 1);
+  record.setId(id, sizeof(id));
+  record.setPayload((const byte *)config, sizeof(config) - 1);
+
+  NdefMessage plain = NdefMessage();
+  plain.addRecord(record);
+  NdefMessage compressed = NdefMessage();
+  compressed.addRecord(record, true);
+
+  unsigned long plainSize = plain.getEncodedSize();
+  unsigned long compressedSize = compressed.getEncodedSize();
+  uint8_t encoded[compressedSize];
+  compressed.encode(encoded);
+
+  unsigned long start = micros();
+  for (int i = 0; i < CODEC_ROUNDS; i++)
+  {
+    NdefMessage m = NdefMessage();
+    m.addRecord(record, true);
+    sink += m.getEncodedSize();
+  }
+  unsigned long compressTime = (micros() - start) / CODEC_ROUNDS;
+
+  NdefMessage decoded = NdefMessage();
+  start = micros();
+  for (int i = 0; i < CODEC_ROUNDS; i++)
+  {
+    sink += decoded.decode(encoded, sizeof(encoded));
+  }
+  unsigned long decodeTime = (micros() - start) / CODEC_ROUNDS;
+
+  Serial.print(plainSize);Serial.print(F(" bytes plain, "));
+  Serial.print(compressedSize);Serial.println(F(" bytes compressed"));
+  // Ultralight pages are 4 bytes, Classic blocks 16
+  Serial.print((plainSize + 3) / 4 - (compressedSize + 3) / 4);Serial.print(F(" Ultralight pages and "));
+  Serial.print((plainSize + 15) / 16 - (compressedSize + 15) / 16);Serial.println(F(" Classic blocks saved"));
+  Serial.print(compressTime);Serial.print(F(" us to add compressed, "));
+  Serial.print(decodeTime);Serial.println(F(" us to decode and expand"));
+}
+//==============================================================================
+// throws away what is printed, only counts the writes it took
+class CountingPrint : public Print
+{
+  public:
+    CountingPrint() : writes(0) {}
+    size_t write(uint8_t b)
+    {
+      return write(&b, 1);
+    }
+    size_t write(const uint8_t *data, size_t size)
+    {
+      writes++;
+      return size;
+    }
+    unsigned long writes;
+};
+
+// how many writes a message takes printed field by field, as
+// NdefMessage::print used to, and through the formatter
+void benchmarkFormat()
+{
+  NdefMessage m = NdefMessage();
+  for (int i = 0; i < 4; i++)
+  {
+    m.addTextRecord("The quick brown fox jumps over the lazy dog");
+  }
+
+  CountingPrint fields;
+  unsigned long start = micros();
+  for (int i = 0; i < FORMAT_ROUNDS; i++)
+  {
+    for (unsigned int r = 0; r < m.getRecordCount(); r++)
+    {
+      const NdefRecord& record = m[r];
+      fields.print(F("    Payload "));
+      for (unsigned int b = 0; b < record.getPayloadLength(); b++)
+      {
+        fields.print(record.getPayload()[b], HEX);
+        fields.print(" ");
+      }
+      fields.println();
+    }
+  }
+  unsigned long fieldsTime = micros() - start;
+
+  CountingPrint staged;
+  start = micros();
+  for (int i = 0; i < FORMAT_ROUNDS; i++)
+  {
+    NdefFormatter formatter(staged);
+    sink += formatter.format(m);
+  }
+  unsigned long stagedTime = micros() - start;
+
+  Serial.print(F("payloads only, field by field "));Serial.print(fields.writes / FORMAT_ROUNDS);
+  Serial.print(F(" writes, "));Serial.print(fieldsTime);Serial.println(F(" us"));
+  Serial.print(F("whole message, formatter      "));Serial.print(staged.writes / FORMAT_ROUNDS);
+  Serial.print(F(" writes, "));Serial.print(stagedTime);Serial.println(F(" us"));
+}
+//==============================================================================
+void setup()
+{
+  Serial.begin(9600);
+  benchmarkView();
+  benchmarkDecode();
+  benchmarkUriPrefix();
+  benchmarkFind();
+  benchmarkCompression();
+  benchmarkFormat();
+}
+//==============================================================================
+void loop()
+{
+}
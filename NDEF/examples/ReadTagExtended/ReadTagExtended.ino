@@ -35,7 +35,8 @@ void loop(void) {
     if (tag.hasNdefMessage()) // every tag won't have a message
     {
 
-      NdefMessage message = tag.getNdefMessage();
+      // references, so the records are read in place rather than copied
+      const NdefMessage& message = tag.getNdefMessage();
       Serial.print("\nThis NFC Tag contains an NDEF Message with ");
       Serial.print(message.getRecordCount());
       Serial.print(" NDEF Record");
@@ -49,17 +50,16 @@ void loop(void) {
       for (int i = 0; i < recordCount; i++)
       {
         Serial.print("\nNDEF Record ");Serial.println(i+1);
-        NdefRecord record = message.getRecord(i);
-        // NdefRecord record = message[i]; // alternate syntax
+        const NdefRecord& record = message.getRecord(i);
+        // const NdefRecord& record = message[i]; // alternate syntax
 
         Serial.print("  TNF: ");Serial.println(record.getTnf());
         Serial.print("  Type: ");Serial.println(record.getType()); // will be "" for TNF_EMPTY
 
         // The TNF and Type should be used to determine how your application processes the payload
-        // There's no generic processing for the payload, it's returned as a byte[]
+        // There's no generic processing for the payload, it's a byte[]
         int payloadLength = record.getPayloadLength();
-        byte payload[payloadLength];
-        record.getPayload(payload);
+        const byte *payload = record.getPayload();
 
         // Print the Hex and Printable Characters
         Serial.print("  Payload (HEX): ");
@@ -0,0 +1,268 @@
+#include <Wire.h>
+#include <PN532.h>
+#include <NdefMessage.h>
+#include <NdefStreamDecoder.h>
+#include <NdefCompression.h>
+#include <ArduinoUnit.h>
+
+const char config[] =
+  "{\"device\":{\"name\":\"sensor-17\",\"room\":\"lab\",\"interval\":60},"
+  "\"wifi\":{\"ssid\":\"workshop\",\"channel\":6,\"retries\":3},"
+  "\"sensors\":[{\"type\":\"temperature\",\"pin\":2,\"unit\":\"C\",\"enabled\":true},"
+  "{\"type\":\"humidity\",\"pin\":3,\"unit\":\"%\",\"enabled\":true},"
+  "{\"type\":\"pressure\",\"pin\":4,\"unit\":\"hPa\",\"enabled\":false},"
+  "{\"type\":\"light\",\"pin\":5,\"unit\":\"lx\",\"enabled\":true}]}";
+
+NdefRecord configRecord()
+{
+  NdefRecord record = NdefRecord();
+  const byte type[] = "application/json";
+  const byte id[] = { 'c' };
+  record.setTnf(TNF_MIME_MEDIA);
+  record.setType(type, sizeof(type) - 1);
+  record.setId(id, sizeof(id));
+  record.setPayload((const byte *)config, sizeof(config) - 1);
+  return record;
+}
+
+// Custom Assertion
+void assertSameRecord(const NdefRecord& expected, const NdefRecord& actual)
+{
+  assertEqual(expected.getTnf(), actual.getTnf());
+  assertTrue(expected.getTypeSpan().equals(actual.getTypeSpan().data, actual.getTypeSpan().length));
+  assertTrue(expected.getIdSpan().equals(actual.getIdSpan().data, actual.getIdSpan().length));
+  assertTrue(expected.getPayloadSpan().equals(actual.getPayloadSpan().data, actual.getPayloadSpan().length));
+}
+
+// decompresses every record it is handed into its own buffer
+class ExpandingSink : public NdefPayloadSink
+{
+  public:
+    ExpandingSink() : decompressor(out, sizeof(out)), status(NDEF_OK) {}
+    void beginRecord(byte tnf, const byte *type, unsigned int typeLength,
+                     const byte *id, unsigned int idLength)
+    {
+      decompressor.reset();
+    }
+    void payload(const byte *data, unsigned int length)
+    {
+      decompressor.write(data, length);
+    }
+    void endRecord()
+    {
+      status = decompressor.finish();
+    }
+    byte out[512];
+    NdefDecompressor decompressor;
+    NdefStatus status;
+};
+
+void setup() {
+  Serial.begin(9600);
+}
+
+test(roundTrip)
+{
+  NdefRecord record = configRecord();
+  NdefMessage plain = NdefMessage();
+  plain.addRecord(record);
+  NdefMessage m = NdefMessage();
+  assertTrue(m.addRecord(record, true));
+
+  // stored compressed, with the id kept outside
+  const NdefRecord& stored = m[0];
+  assertEqual(TNF_EXTERNAL_TYPE, stored.getTnf());
+  assertTrue(stored.getTypeSpan().equals(NDEF_COMPRESSED_TYPE));
+  assertTrue(stored.getIdSpan().equals("c"));
+  assertTrue(m.getEncodedSize() < plain.getEncodedSize());
+  assertEqual(m.getArenaUsed(), stored.getTypeLength() + 1 + stored.getPayloadLength());
+
+  uint8_t encoded[m.getEncodedSize()];
+  m.encode(encoded);
+  NdefMessage decoded = NdefMessage();
+  assertEqual(NDEF_OK, decoded.decode(encoded, sizeof(encoded)));
+  assertEqual(1, decoded.getRecordCount());
+  assertSameRecord(record, decoded[0]);
+  assertEqual(plain.getEncodedSize(), decoded.getEncodedSize());
+}
+
+test(compressOwnRecord)
+{
+  // the record being compressed lives in the arena that grows under it
+  NdefRecord record = configRecord();
+  NdefMessage m = NdefMessage();
+  m.addRecord(record);
+  for (int i = 0; i < 3; i++) {
+    assertTrue(m.addRecord(m[0], true));
+  }
+  assertEqual(4, m.getRecordCount());
+
+  uint8_t encoded[m.getEncodedSize()];
+  m.encode(encoded);
+  NdefMessage decoded = NdefMessage();
+  assertEqual(NDEF_OK, decoded.decode(encoded, sizeof(encoded)));
+  for (unsigned int i = 0; i < decoded.getRecordCount(); i++) {
+    assertSameRecord(record, decoded[i]);
+  }
+}
+
+test(notWorthIt)
+{
+  // nothing repeats, so the record is added as it is
+  byte noise[64];
+  for (unsigned int i = 0; i < sizeof(noise); i++) {
+    noise[i] = (i * 113 + 7) ^ (i >> 3);
+  }
+  NdefMessage m = NdefMessage();
+  m.addRecord(configRecord(), true);
+  const byte type[] = { 'x' };
+  NdefRecord record = NdefRecord();
+  record.setTnf(TNF_MIME_MEDIA);
+  record.setType(type, sizeof(type));
+  record.setPayload(noise, sizeof(noise));
+  assertTrue(m.addRecord(record, true));
+
+  assertEqual(2, m.getRecordCount());
+  assertSameRecord(record, m[1]);
+  assertEqual(TNF_EMPTY, (m.addRecord(NdefRecord(), true), m[2].getTnf()));
+}
+
+test(streamDecoderExpands)
+{
+  NdefMessage m = NdefMessage();
+  m.addTextRecord("before");
+  m.addRecord(configRecord(), true);
+  uint8_t encoded[m.getEncodedSize()];
+  m.encode(encoded);
+
+  NdefMessage decoded = NdefMessage();
+  NdefStreamDecoder decoder(decoded);
+  for (unsigned int i = 0; i < sizeof(encoded); i += 4) {
+    unsigned int n = sizeof(encoded) - i < 4 ? sizeof(encoded) - i : 4;
+    assertEqual(NDEF_OK, decoder.write(&encoded[i], n));
+  }
+  assertEqual(NDEF_OK, decoder.finish());
+  assertEqual(2, decoded.getRecordCount());
+  assertSameRecord(configRecord(), decoded[1]);
+}
+
+test(decompressIntoCallerMemory)
+{
+  NdefMessage m = NdefMessage();
+  m.addRecord(configRecord(), true);
+  uint8_t encoded[m.getEncodedSize()];
+  m.encode(encoded);
+
+  // a byte at a time, the way pages come off a tag
+  ExpandingSink sink;
+  NdefStreamDecoder decoder(sink);
+  for (unsigned int i = 0; i < sizeof(encoded); i++) {
+    decoder.write(&encoded[i], 1);
+  }
+  assertEqual(NDEF_OK, decoder.finish());
+  assertEqual(NDEF_OK, sink.status);
+  assertEqual(TNF_MIME_MEDIA, sink.decompressor.getTnf());
+  assertTrue(sink.decompressor.getType().equals("application/json"));
+  assertTrue(sink.decompressor.getPayload().equals(config));
+}
+
+test(malformed)
+{
+  NdefMessage m = NdefMessage();
+  m.addRecord(configRecord(), true);
+  uint8_t encoded[m.getEncodedSize()];
+  m.encode(encoded);
+  // the one record's payload ends the message
+  unsigned int payloadStart = sizeof(encoded) - m[0].getPayloadLength();
+  // past the original type and payload length
+  unsigned int streamStart = payloadStart + NdefCompressedHeaderSize(16);
+
+  NdefMessage decoded = NdefMessage();
+  // a match reaching back before the payload
+  uint8_t badOffset[sizeof(encoded)];
+  memcpy(badOffset, encoded, sizeof(encoded));
+  badOffset[streamStart] = 0x80;
+  badOffset[streamStart + 1] = 0xFF;
+  assertEqual(NDEF_ERROR_COMPRESSION, decoded.decode(badOffset, sizeof(badOffset)));
+  assertEqual(0, decoded.getRecordCount());
+
+  // an unknown format
+  uint8_t badFormat[sizeof(encoded)];
+  memcpy(badFormat, encoded, sizeof(encoded));
+  badFormat[payloadStart] = 0x7F;
+  assertEqual(NDEF_ERROR_COMPRESSION, decoded.decode(badFormat, sizeof(badFormat)));
+
+  // a longer payload than the stream gives
+  uint8_t badLength[sizeof(encoded)];
+  memcpy(badLength, encoded, sizeof(encoded));
+  badLength[streamStart - 1]++;
+  assertEqual(NDEF_ERROR_COMPRESSION, decoded.decode(badLength, sizeof(badLength)));
+
+  // a length no stream of this size could reach, refused before the
+  // arena grows to hold it
+  uint8_t hugeLength[sizeof(encoded)];
+  memcpy(hugeLength, encoded, sizeof(encoded));
+  hugeLength[streamStart - 4] = 0xFF;
+  NdefMessage huge = NdefMessage();
+  assertEqual(NDEF_ERROR_COMPRESSION, huge.decode(hugeLength, sizeof(hugeLength)));
+  assertTrue(huge.getArenaSize() <= sizeof(encoded));
+
+  // any byte of the compressed payload changed decodes or fails cleanly
+  for (unsigned int i = payloadStart; i < sizeof(encoded); i++) {
+    uint8_t corrupt[sizeof(encoded)];
+    memcpy(corrupt, encoded, sizeof(encoded));
+    corrupt[i] ^= 0x5A;
+    if (decoded.decode(corrupt, sizeof(corrupt)) == NDEF_OK) {
+      assertEqual(1, decoded.getRecordCount());
+    }
+  }
+
+  // too big for a caller's arena
+  byte arena[64];
+  NdefMessage small = NdefMessage();
+  small.setArena(arena, sizeof(arena));
+  assertEqual(NDEF_ERROR_NO_MEMORY, small.decode(encoded, sizeof(encoded)));
+}
+
+test(codecEdges)
+{
+  byte out[NDEF_LZ_BOUND(300)];
+  byte data[300];
+  byte back[300];
+  // a single repeated byte, overlapping matches
+  memset(data, 'a', sizeof(data));
+  uint32_t size = NdefLzCompress(data, sizeof(data), out, sizeof(out));
+  assertTrue(size > 0 && size < 20);
+  assertEqual(0, NdefLzCompress(data, sizeof(data), out, 4));
+  // nothing at all
+  assertEqual(0, NdefLzCompress(data, 0, out, sizeof(out)));
+
+  byte payload[8 + 20];
+  payload[0] = NDEF_LZ_FORMAT;
+  payload[1] = TNF_MIME_MEDIA;
+  payload[2] = 0;
+  payload[3] = 0;
+  payload[4] = 0;
+  payload[5] = 300 >> 8;
+  payload[6] = 300 & 0xFF;
+  memcpy(&payload[7], out, size);
+  NdefSpan span = { payload, 7 + (unsigned int)size };
+  assertEqual(300, NdefDecompressedSize(span));
+  // a length the stream cannot back up
+  payload[3] = 0xFF;
+  assertEqual(0, NdefDecompressedSize(span));
+  payload[3] = 0;
+
+  NdefDecompressor decompressor(back, sizeof(back));
+  assertEqual(NDEF_OK, decompressor.write(payload, 7 + size));
+  assertEqual(NDEF_OK, decompressor.finish());
+  assertEqual(0, memcmp(data, back, sizeof(data)));
+
+  // out too small for what the header promises
+  NdefDecompressor tooSmall(back, 100);
+  assertEqual(NDEF_ERROR_NO_MEMORY, tooSmall.write(payload, 7 + size));
+}
+
+void loop() {
+  Test::run();
+}
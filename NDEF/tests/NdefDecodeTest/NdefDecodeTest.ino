@@ -0,0 +1,159 @@
+#include <Wire.h>
+#include <PN532.h>
+#include <NdefMessage.h>
+#include <ArduinoUnit.h>
+
+// Custom Assertion
+void assertDecodeFails(NdefStatus expected, const uint8_t* data, unsigned int size)
+{
+  NdefMessage m = NdefMessage();
+  m.addEmptyRecord();
+  assertEqual(expected, m.decode(data, size));
+  // nothing half decoded is left behind
+  assertEqual(0, m.getRecordCount());
+  assertEqual(0, m.getArenaUsed());
+}
+
+void setup() {
+  Serial.begin(9600);
+}
+
+test(decodeStatus)
+{
+  uint8_t encoded[] = { 0xD1, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F };
+  NdefMessage m = NdefMessage();
+  assertEqual(NDEF_OK, m.decode(encoded, sizeof(encoded)));
+  assertEqual(1, m.getRecordCount());
+
+  // decoding again replaces the records
+  assertEqual(NDEF_OK, m.decode(encoded, sizeof(encoded)));
+  assertEqual(1, m.getRecordCount());
+  assertEqual(7, m.getArenaUsed());
+}
+
+test(trailingBytesIgnored)
+{
+  // terminator TLV and padding after the message
+  uint8_t encoded[] = { 0xD1, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F, 0xFE, 0x00, 0x00 };
+  NdefMessage m = NdefMessage();
+  assertEqual(NDEF_OK, m.decode(encoded, sizeof(encoded)));
+  assertEqual(6, m[0].getPayloadLength());
+}
+
+test(chunksJoined)
+{
+  // "en" "foo" split over three chunks, the first with an id
+  uint8_t encoded[] = {
+    0xB9, 0x01, 0x02, 0x01, 0x54, 0x69, 0x02, 0x65,
+    0x36, 0x00, 0x02, 0x6E, 0x66,
+    0x56, 0x00, 0x02, 0x6F, 0x6F
+  };
+  uint8_t payload[] = { 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F };
+
+  NdefMessage m = NdefMessage();
+  assertEqual(NDEF_OK, m.decode(encoded, sizeof(encoded)));
+  assertEqual(1, m.getRecordCount());
+
+  const NdefRecord& r = m[0];
+  assertEqual(TNF_WELL_KNOWN, r.getTnf());
+  assertEqual(1, r.getIdLength());
+  assertEqual(6, r.getPayloadLength());
+  for (unsigned int i = 0; i < sizeof(payload); i++) {
+    assertEqual(payload[i], r.getPayload()[i]);
+  }
+}
+
+test(malformedEmpty)
+{
+  uint8_t encoded[] = { 0xD1 };
+  assertDecodeFails(NDEF_ERROR_EMPTY, encoded, 0);
+  assertDecodeFails(NDEF_ERROR_EMPTY, NULL, 10);
+}
+
+test(malformedTruncated)
+{
+  uint8_t header[] = { 0xD1 };
+  uint8_t payload[] = { 0xD1, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F };
+  uint8_t longLength[] = { 0xC1, 0x01, 0x00, 0x00 };
+  // a 4 GB payload must not wrap around the length check
+  uint8_t hugePayload[] = { 0xC1, 0x01, 0xFF, 0xFF, 0xFF, 0xFE, 0x54, 0x00 };
+  uint8_t id[] = { 0xD9, 0x01, 0x00, 0x05, 0x54, 0x01 };
+
+  assertDecodeFails(NDEF_ERROR_TRUNCATED, header, sizeof(header));
+  assertDecodeFails(NDEF_ERROR_TRUNCATED, payload, sizeof(payload));
+  assertDecodeFails(NDEF_ERROR_TRUNCATED, longLength, sizeof(longLength));
+  assertDecodeFails(NDEF_ERROR_TRUNCATED, hugePayload, sizeof(hugePayload));
+  assertDecodeFails(NDEF_ERROR_TRUNCATED, id, sizeof(id));
+}
+
+test(malformedFlags)
+{
+  uint8_t noBegin[] = { 0x51, 0x01, 0x00, 0x54 };
+  uint8_t secondBegin[] = { 0x91, 0x01, 0x00, 0x54, 0xD1, 0x01, 0x00, 0x54 };
+  uint8_t noEnd[] = { 0x91, 0x01, 0x00, 0x54, 0x11, 0x01, 0x00, 0x54 };
+
+  assertDecodeFails(NDEF_ERROR_MESSAGE_BEGIN, noBegin, sizeof(noBegin));
+  assertDecodeFails(NDEF_ERROR_MESSAGE_BEGIN, secondBegin, sizeof(secondBegin));
+  assertDecodeFails(NDEF_ERROR_MESSAGE_END, noEnd, sizeof(noEnd));
+}
+
+test(malformedTnf)
+{
+  uint8_t reserved[] = { 0xD7, 0x00, 0x00 };
+  uint8_t emptyWithPayload[] = { 0xD0, 0x00, 0x01, 0x00 };
+  uint8_t unknownWithType[] = { 0xD5, 0x01, 0x00, 0x54 };
+
+  assertDecodeFails(NDEF_ERROR_TNF, reserved, sizeof(reserved));
+  assertDecodeFails(NDEF_ERROR_TNF, emptyWithPayload, sizeof(emptyWithPayload));
+  assertDecodeFails(NDEF_ERROR_TNF, unknownWithType, sizeof(unknownWithType));
+}
+
+test(malformedChunks)
+{
+  // unchanged without a chunk before it
+  uint8_t unchanged[] = { 0xD6, 0x00, 0x00 };
+  // the message ends on a chunk
+  uint8_t openChunk[] = { 0xF1, 0x01, 0x00, 0x54 };
+  // a chunk that carries a type
+  uint8_t typedChunk[] = { 0xB1, 0x01, 0x00, 0x54, 0x56, 0x01, 0x00, 0x54 };
+  // a chunk with a different tnf
+  uint8_t otherTnf[] = { 0xB1, 0x01, 0x00, 0x54, 0x55, 0x00, 0x00 };
+
+  assertDecodeFails(NDEF_ERROR_CHUNK, unchanged, sizeof(unchanged));
+  assertDecodeFails(NDEF_ERROR_CHUNK, openChunk, sizeof(openChunk));
+  assertDecodeFails(NDEF_ERROR_CHUNK, typedChunk, sizeof(typedChunk));
+  assertDecodeFails(NDEF_ERROR_CHUNK, otherTnf, sizeof(otherTnf));
+}
+
+test(malformedNoMemory)
+{
+  uint8_t arena[4];
+  uint8_t encoded[] = { 0xD1, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F };
+  NdefMessage m = NdefMessage();
+  m.setArena(arena, sizeof(arena));
+  assertEqual(NDEF_ERROR_NO_MEMORY, m.decode(encoded, sizeof(encoded)));
+  assertEqual(0, m.getRecordCount());
+}
+
+test(malformedEveryPrefix)
+{
+  // every cut of a valid message is rejected, none read past the end
+  uint8_t encoded[] = {
+    0x91, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F,
+    0x59, 0x01, 0x02, 0x01, 0x55, 0x69, 0x00, 0x61
+  };
+  for (unsigned int size = 0; size < sizeof(encoded); size++) {
+    uint8_t *copy = (uint8_t *)malloc(size + 1);
+    memcpy(copy, encoded, size);
+    NdefMessage m = NdefMessage();
+    assertTrue(m.decode(copy, size) != NDEF_OK);
+    free(copy);
+  }
+  NdefMessage m = NdefMessage();
+  assertEqual(NDEF_OK, m.decode(encoded, sizeof(encoded)));
+  assertEqual(2, m.getRecordCount());
+}
+
+void loop() {
+  Test::run();
+}
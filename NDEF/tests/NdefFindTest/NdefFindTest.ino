@@ -0,0 +1,115 @@
+#include <Wire.h>
+#include <PN532.h>
+#include <NdefMessage.h>
+#include <ArduinoUnit.h>
+
+const byte payload[] = { 0x01, 0x02 };
+
+// count records of one type into a counter, as a gateway routing them would
+unsigned int visited;
+void countRecord(const NdefRecord& record)
+{
+  visited++;
+}
+
+// records that differ by type, all the same tnf and type length
+void addMimeRecords(NdefMessage& m, int count)
+{
+  char type[] = "application/vnd.x00";
+  for (int i = 0; i < count; i++) {
+    type[17] = '0' + i / 10;
+    type[18] = '0' + i % 10;
+    m.addMimeMediaRecord(type, payload, sizeof(payload));
+  }
+}
+
+void setup() {
+  Serial.begin(9600);
+}
+
+test(findRecord)
+{
+  NdefMessage m = NdefMessage();
+  m.addTextRecord("hello");
+  m.addUriRecord("http://arduino.cc");
+  m.addMimeMediaRecord("application/vnd.x", payload, sizeof(payload));
+  m.addTextRecord("world");
+  m.addEmptyRecord();
+
+  // the record in place, not a copy
+  assertTrue(m.findRecord(TNF_WELL_KNOWN, "U") == &m[1]);
+  assertTrue(m.findRecord(TNF_WELL_KNOWN, "T") == &m[0]);
+  assertTrue(m.findRecord(TNF_MIME_MEDIA, "application/vnd.x") == &m[2]);
+  assertTrue(m.findRecord(TNF_EMPTY, "") == &m[4]);
+
+  // tnf and type both have to match
+  assertTrue(m.findRecord(TNF_MIME_MEDIA, "U") == NULL);
+  assertTrue(m.findRecord(TNF_WELL_KNOWN, "Sp") == NULL);
+  assertTrue(m.findRecord(TNF_MIME_MEDIA, "application/vnd") == NULL);
+
+  assertEqual(3, m.findRecordIndex(TNF_WELL_KNOWN, (const byte *)"T", 1, 1));
+  assertEqual(-1, m.findRecordIndex(TNF_WELL_KNOWN, (const byte *)"T", 1, 4));
+}
+
+test(forEachRecord)
+{
+  NdefMessage m = NdefMessage();
+  m.addTextRecord("a");
+  m.addUriRecord("http://arduino.cc");
+  m.addTextRecord("b");
+  m.addTextRecord("c");
+
+  visited = 0;
+  assertEqual(3, m.forEachRecord(TNF_WELL_KNOWN, "T", countRecord));
+  assertEqual(3, visited);
+
+  unsigned long bytes = 0;
+  m.forEachRecord(TNF_WELL_KNOWN, "T", [&bytes](const NdefRecord& record) {
+    bytes += record.getPayloadLength();
+  });
+  assertEqual(3 * 4UL, bytes);
+  assertEqual(0, m.forEachRecord(TNF_WELL_KNOWN, "Sp", countRecord));
+}
+
+test(indexFollowsChanges)
+{
+  NdefMessage m = NdefMessage();
+  addMimeRecords(m, 3);
+  assertTrue(m.findRecord(TNF_MIME_MEDIA, "application/vnd.x02") == &m[2]);
+
+  // records added after a lookup are found too
+  m.addUriRecord("http://arduino.cc");
+  assertTrue(m.findRecord(TNF_WELL_KNOWN, "U") == &m[3]);
+
+  // and a message decoded over the old one is indexed anew
+  uint8_t encoded[] = { 0xD1, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F };
+  assertEqual(NDEF_OK, m.decode(encoded, sizeof(encoded)));
+  assertTrue(m.findRecord(TNF_WELL_KNOWN, "U") == NULL);
+  assertTrue(m.findRecord(TNF_WELL_KNOWN, "T") == &m[0]);
+
+  // copies and moves carry the records, not stale hashes
+  NdefMessage copy = m;
+  assertTrue(copy.findRecord(TNF_WELL_KNOWN, "T") == &copy[0]);
+  NdefMessage moved = static_cast<NdefMessage&&>(copy);
+  assertTrue(moved.findRecord(TNF_WELL_KNOWN, "T") == &moved[0]);
+  assertTrue(copy.findRecord(TNF_WELL_KNOWN, "T") == NULL);
+}
+
+#if !defined(__AVR__)
+// 64 records take well over the 2 kB of an Uno
+test(manyRecords)
+{
+  NdefMessage m = NdefMessage();
+  addMimeRecords(m, 64);
+  char type[] = "application/vnd.x00";
+  for (int i = 0; i < 64; i++) {
+    type[17] = '0' + i / 10;
+    type[18] = '0' + i % 10;
+    assertTrue(m.findRecord(TNF_MIME_MEDIA, type) == &m[i]);
+  }
+}
+#endif
+
+void loop() {
+  Test::run();
+}
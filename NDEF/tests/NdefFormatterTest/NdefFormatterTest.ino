@@ -0,0 +1,156 @@
+#include <Wire.h>
+#include <PN532.h>
+#include <NdefMessage.h>
+#include <NdefFormatter.h>
+#include <ArduinoUnit.h>
+
+// text "en" "foo", then mime "a/b" with id 0xAB and payload 0x01
+uint8_t encoded[] = {
+  0x91, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F,
+  0x5A, 0x03, 0x01, 0x01, 0x61, 0x2F, 0x62, 0xAB, 0x01
+};
+uint8_t text[] = { 0xD1, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F };
+
+// keeps what is printed and counts the writes it took
+class CapturePrint : public Print
+{
+  public:
+    CapturePrint() : length(0), writes(0) {}
+    size_t write(uint8_t b)
+    {
+      return write(&b, 1);
+    }
+    size_t write(const uint8_t *data, size_t size)
+    {
+      writes++;
+      for (size_t i = 0; i < size && length < sizeof(text) - 1; i++) {
+        text[length++] = data[i];
+      }
+      text[length] = 0;
+      return size;
+    }
+    char text[512];
+    unsigned int length;
+    int writes;
+};
+
+void setup() {
+  Serial.begin(9600);
+}
+
+test(json)
+{
+  NdefMessage m = NdefMessage();
+  assertEqual(NDEF_OK, m.decode(encoded, sizeof(encoded)));
+
+  CapturePrint out;
+  NdefFormatter formatter(out, NDEF_FORMAT_JSON);
+  assertTrue(formatter.format(m));
+  assertEqual(0, strcmp("{\"size\":19,\"records\":["
+              "{\"tnf\":1,\"type\":\"T\",\"payload\":\"02656E666F6F\"},"
+              "{\"tnf\":2,\"type\":\"a/b\",\"id\":\"AB\",\"payload\":\"01\"}]}", out.text));
+  assertEqual(2, out.writes);
+}
+
+test(jsonEscapesType)
+{
+  byte type[] = { 'a', '"', '\\', 0x01 };
+  NdefRecord r = NdefRecord();
+  r.setTnf(TNF_EXTERNAL_TYPE);
+  r.setType(type, sizeof(type));
+
+  CapturePrint out;
+  NdefFormatter formatter(out, NDEF_FORMAT_JSON);
+  assertTrue(formatter.format(r));
+  assertEqual(1, out.writes);
+  assertEqual(0, strcmp("{\"tnf\":4,\"type\":\"a\\\"\\\\\\u0001\",\"payload\":\"\"}", out.text));
+}
+
+test(cbor)
+{
+  uint8_t expected[] = {
+    0xA2, 0x64, 's', 'i', 'z', 'e', 0x0A,
+    0x67, 'r', 'e', 'c', 'o', 'r', 'd', 's', 0x81,
+    0xA3, 0x63, 't', 'n', 'f', 0x01,
+    0x64, 't', 'y', 'p', 'e', 0x41, 0x54,
+    0x67, 'p', 'a', 'y', 'l', 'o', 'a', 'd', 0x46, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F
+  };
+  NdefMessage m = NdefMessage();
+  assertEqual(NDEF_OK, m.decode(text, sizeof(text)));
+
+  byte buffer[64];
+  NdefBufferSink sink(buffer, sizeof(buffer));
+  NdefFormatter formatter(sink, NDEF_FORMAT_CBOR);
+  assertTrue(formatter.format(m));
+  assertEqual((unsigned int)sizeof(expected), sink.getLength());
+  for (unsigned int i = 0; i < sizeof(expected); i++) {
+    assertEqual(expected[i], buffer[i]);
+  }
+}
+
+test(cborLongPayload)
+{
+  // 300 bytes need a two byte length, and skip the staging buffer
+  byte payload[300];
+  memset(payload, 0x5A, sizeof(payload));
+  NdefMessage m = NdefMessage();
+  m.addMimeMediaRecord("a/b", payload, sizeof(payload));
+
+  CapturePrint out;
+  NdefFormatter formatter(out, NDEF_FORMAT_CBOR);
+  assertTrue(formatter.format(m));
+  assertEqual(2, out.writes);
+  // header, size 310, records, tnf, type and the payload length
+  unsigned int head = 1 + 5 + 3 + 8 + 1 + 1 + 4 + 1 + 5 + 4 + 8 + 3;
+  assertEqual(head + (unsigned int)sizeof(payload), out.length);
+  assertEqual(0x59, (byte)out.text[head - 3]);
+  assertEqual(0x01, (byte)out.text[head - 2]);
+  assertEqual(0x2C, (byte)out.text[head - 1]);
+}
+
+test(human)
+{
+  NdefMessage m = NdefMessage();
+  assertEqual(NDEF_OK, m.decode(text, sizeof(text)));
+
+  CapturePrint out;
+  NdefFormatter formatter(out);
+  assertTrue(formatter.format(m));
+  assertEqual(0, strcmp("\nNDEF Message 1 record, 10 bytes\r\n"
+              "  NDEF Record\r\n"
+              "    TNF 0x1 Well Known\r\n"
+              "    Type Length 0x1 1\r\n"
+              "    Payload Length 0x6 6\r\n"
+              "    Type 54  T\r\n"
+              "    Payload 02 65 6E 66 6F 6F  .enfoo\r\n"
+              "    Record is 10 bytes\r\n", out.text));
+  assertTrue(out.writes <= (int)(out.length / NDEF_FORMAT_BUFFER) + 1);
+}
+
+test(sinkFull)
+{
+  NdefMessage m = NdefMessage();
+  assertEqual(NDEF_OK, m.decode(encoded, sizeof(encoded)));
+
+  byte buffer[16];
+  NdefBufferSink sink(buffer, sizeof(buffer));
+  NdefFormatter formatter(sink, NDEF_FORMAT_JSON);
+  assertFalse(formatter.format(m));
+  assertFalse(formatter.flush());
+}
+
+test(recordSinkFull)
+{
+  NdefRecord r = NdefRecord();
+  r.setTnf(TNF_MIME_MEDIA);
+  r.setType((const byte *)"a/b", 3);
+
+  byte buffer[8];
+  NdefBufferSink sink(buffer, sizeof(buffer));
+  NdefFormatter formatter(sink, NDEF_FORMAT_JSON);
+  assertFalse(formatter.format(r));
+}
+
+void loop() {
+  Test::run();
+}
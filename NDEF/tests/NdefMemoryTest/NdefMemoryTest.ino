@@ -141,6 +141,32 @@ void message120()
   //message.print();
 }
 
+void messageDecode()
+{
+  uint8_t encoded[] = { 0xD1, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F };
+  NdefMessage m = NdefMessage(encoded, sizeof(encoded));
+  NdefMessage copy = m;
+  copy = m;
+}
+
+void messageWithArena()
+{
+  uint8_t arena[32];
+  uint8_t encoded[] = { 0xD1, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F };
+  NdefMessage m = NdefMessage(encoded, sizeof(encoded), arena, sizeof(arena));
+  m.addEmptyRecord();
+}
+
+void messageManyRecords()
+{
+  NdefMessage m = NdefMessage();
+  for (int i = 0; i < 6; i++) {
+    m.addUriRecord("http://arduino.cc");
+  }
+  NdefMessage copy = m;
+  NdefMessageN<4> moved = static_cast<NdefMessage&&>(m);
+}
+
 void setup() {
   Serial.begin(9600);
   Serial.println("\n");
@@ -180,6 +206,43 @@ test(messageLeaks)
   assertNoLeak(&messageWithId);
 }
 
+test(messageArenaLeaks)
+{
+  assertNoLeak(&messageDecode);
+  assertNoLeak(&messageWithArena);
+}
+
+test(messageRecordTableLeaks)
+{
+  assertNoLeak(&messageManyRecords);
+}
+
+test(messageWithArenaDoesNotAllocate)
+{
+  uint8_t arena[32];
+  uint8_t encoded[] = { 0xD1, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F };
+  int start = freeMemory();
+  NdefMessage m = NdefMessage(encoded, sizeof(encoded), arena, sizeof(arena));
+  m.addEmptyRecord();
+  // measured while m is still alive
+  assertEqual(0, (start - freeMemory()));
+  assertEqual(2, m.getRecordCount());
+}
+
+test(buildersDoNotAllocate)
+{
+  uint8_t arena[48];
+  uint8_t payload[] = { 0x01, 0x02, 0x03 };
+  int start = freeMemory();
+  NdefMessageN<3> m = NdefMessageN<3>();
+  m.setArena(arena, sizeof(arena));
+  assertTrue(m.addTextRecord("hello", "en"));
+  assertTrue(m.addUriRecord("http://arduino.cc"));
+  assertTrue(m.addMimeMediaRecord("a/b", payload, sizeof(payload)));
+  assertEqual(0, (start - freeMemory()));
+  assertEqual(3, m.getRecordCount());
+}
+
 test(messageOneBigRecord)
 {
   assertNoLeak(&message80);
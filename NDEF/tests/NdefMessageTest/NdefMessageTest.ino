@@ -2,6 +2,7 @@
 #include <PN532.h>
 #include <NdefMessage.h>
 #include <NdefRecord.h>
+#include <NdefSink.h>
 #include <ArduinoUnit.h>
 
 // Custom Assertion
@@ -218,6 +219,431 @@ test(doublePayload)
   assertEqual(0, (start-end));
 }
 
+test(arenaDecode)
+{
+  uint8_t encoded[] = { 0xD1, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F };
+
+  NdefMessage m = NdefMessage(encoded, sizeof(encoded));
+  assertEqual(1, m.getRecordCount());
+  // type and payload, carved from one block sized for the whole message
+  assertEqual(7, m.getArenaUsed());
+  assertEqual((int)sizeof(encoded), m.getArenaSize());
+
+  uint8_t buffer[sizeof(encoded)];
+  m.encode(buffer);
+  assertBytesEqual(encoded, buffer, sizeof(encoded));
+}
+
+test(arenaCallerSupplied)
+{
+  uint8_t arena[12];
+  NdefMessage m = NdefMessage();
+  assertTrue(m.setArena(arena, sizeof(arena)));
+
+  uint8_t type[] = { 0x54 };
+  uint8_t payload[] = { 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F };
+  NdefRecord r = NdefRecord();
+  r.setTnf(TNF_WELL_KNOWN);
+  r.setType(type, sizeof(type));
+  r.setPayload(payload, sizeof(payload));
+
+  assertTrue(m.addRecord(r));
+  assertEqual(7, m.getArenaUsed());
+  // the record bytes live in the caller's buffer
+  assertEqual(0x54, arena[0]);
+  assertEqual(0x02, arena[1]);
+
+  // 7 + 7 > 12, and a caller's arena never grows
+  assertFalse(m.addRecord(r));
+  assertEqual(1, m.getRecordCount());
+  assertEqual((int)sizeof(arena), m.getArenaSize());
+
+  // only an empty message can switch arenas
+  assertFalse(m.setArena(arena, sizeof(arena)));
+
+  // a copy owns its own arena
+  NdefMessage copy = m;
+  arena[0] = 0;
+  NdefRecord c = copy.getRecord(0);
+  byte copiedType[1];
+  c.getType(copiedType);
+  assertEqual(0x54, copiedType[0]);
+  assertEqual(6, c.getPayloadLength());
+}
+
+test(arenaGrows)
+{
+  NdefMessage m = NdefMessage();
+  m.addUriRecord("http://arduino.cc");
+  m.addTextRecord("hello, world");
+  m.addMimeMediaRecord("text/plain", "hi");
+  m.addEmptyRecord();
+  assertEqual(4, m.getRecordCount());
+  // "http://" is stored as its one byte code
+  assertEqual(1 + 11 + 1 + 15 + 10 + 2, m.getArenaUsed());
+  assertTrue(m.getArenaSize() >= m.getArenaUsed());
+
+  uint8_t encoded[m.getEncodedSize()];
+  m.encode(encoded);
+  NdefMessage decoded = NdefMessage(encoded, sizeof(encoded));
+  assertEqual(4, decoded.getRecordCount());
+  assertEqual(m.getArenaUsed(), decoded.getArenaUsed());
+
+  // changing a copy of a record leaves the message alone
+  NdefRecord r = m.getRecord(1);
+  uint8_t payload[] = { 0x02, 0x65, 0x6E };
+  r.setPayload(payload, sizeof(payload));
+  assertEqual(15, m.getRecord(1).getPayloadLength());
+}
+
+test(recordByReference)
+{
+  NdefMessage m = NdefMessage();
+  m.addTextRecord("foo");
+
+  const NdefRecord& r1 = m.getRecord(0);
+  const NdefRecord& r2 = m[0];
+  assertTrue(&r1 == &r2);
+  assertTrue(r1.getPayload() == m.getRecord(0).getPayload());
+
+  // out of range gives an empty record rather than a copy
+  assertEqual(TNF_EMPTY, m.getRecord(4).getTnf());
+  assertEqual(0, m.getRecord(-1).getPayloadLength());
+}
+
+test(addOwnRecord)
+{
+  // adding a record of the message to itself, while the arena and the
+  // record table both have to grow
+  NdefMessage m = NdefMessage();
+  m.addTextRecord("hello, world");
+  uint8_t id[] = { 0x69 };
+  NdefRecord r = NdefRecord();
+  r.setTnf(TNF_WELL_KNOWN);
+  r.setType(id, sizeof(id));
+  r.setId(id, sizeof(id));
+  m.addRecord(r);
+
+  for (int i = 0; i < 6; i++) {
+    assertTrue(m.addRecord(m[0]));
+    assertTrue(m.addRecord(m[1]));
+  }
+  assertEqual(14, m.getRecordCount());
+  for (unsigned int i = 2; i < m.getRecordCount(); i++) {
+    const NdefRecord& expected = m[i % 2];
+    assertEqual(expected.getPayloadLength(), m[i].getPayloadLength());
+    assertEqual(0, memcmp(expected.getPayload(), m[i].getPayload(), expected.getPayloadLength()));
+    assertEqual(expected.getIdLength(), m[i].getIdLength());
+    assertTrue(m[i].getTypeSpan().equals(expected.getTypeSpan().data, expected.getTypeSpan().length));
+  }
+}
+
+test(emplaceRecord)
+{
+  uint8_t type[] = { 0x54 };
+  uint8_t payload[] = { 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F };
+  uint8_t id[] = { 0x0, 0x1 };
+  uint8_t expected[] = { 0xD9, 0x01, 0x06, 0x02, 0x54, 0x0, 0x1, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F };
+
+  NdefMessage m = NdefMessage();
+  assertTrue(m.emplaceRecord(TNF_WELL_KNOWN, type, sizeof(type), payload, sizeof(payload), id, sizeof(id)));
+  assertEqual((int)sizeof(expected), m.getEncodedSize());
+
+  uint8_t encoded[sizeof(expected)];
+  m.encode(encoded);
+  assertBytesEqual(expected, encoded, sizeof(expected));
+}
+
+test(moveMessage)
+{
+  NdefMessage m1 = NdefMessage();
+  m1.addTextRecord("foo");
+  m1.addUriRecord("http://arduino.cc");
+  const byte *payload = m1[1].getPayload();
+
+  NdefMessage m2 = static_cast<NdefMessage&&>(m1);
+  assertEqual(0, m1.getRecordCount());
+  assertEqual(0, m1.getArenaSize());
+  assertEqual(2, m2.getRecordCount());
+  assertTrue(payload == m2[1].getPayload());
+
+  NdefMessage m3 = NdefMessage();
+  m3.addEmptyRecord();
+  m3 = static_cast<NdefMessage&&>(m2);
+  assertEqual(2, m3.getRecordCount());
+  assertTrue(payload == m3[1].getPayload());
+
+  // a moved-from message is still usable
+  m2.addTextRecord("bar");
+  assertEqual(1, m2.getRecordCount());
+}
+
+test(moveRecord)
+{
+  NdefRecord r = NdefRecord();
+  uint8_t payload[] = { 0x1, 0x2, 0x3 };
+  r.setPayload(payload, sizeof(payload));
+  const byte *bytes = r.getPayload();
+
+  NdefRecord moved = static_cast<NdefRecord&&>(r);
+  assertEqual(0, r.getPayloadLength());
+  assertEqual(3, moved.getPayloadLength());
+  assertTrue(bytes == moved.getPayload());
+}
+
+test(manyRecords)
+{
+  NdefMessage m = NdefMessage();
+  for (int i = 0; i < 6; i++) {
+    m.addTextRecord(String(i));
+  }
+  assertEqual(6, m.getRecordCount());
+  assertTrue(m.getRecordCapacity() >= 6);
+
+  uint8_t encoded[m.getEncodedSize()];
+  m.encode(encoded);
+  // the last record is the only one flagged ME
+  assertEqual(0x91, encoded[0]);
+  assertEqual(0x51, encoded[5 * 8]);
+
+  NdefMessage decoded = NdefMessage(encoded, sizeof(encoded));
+  assertEqual(6, decoded.getRecordCount());
+  for (int i = 0; i < 6; i++) {
+    assertEqual('0' + i, decoded[i].getPayload()[3]);
+  }
+}
+
+test(inlineCapacity)
+{
+  NdefMessage m = NdefMessage();
+  assertEqual(NDEF_INLINE_RECORDS, m.getRecordCapacity());
+
+  NdefMessageN<6> n = NdefMessageN<6>();
+  assertEqual(6, n.getRecordCapacity());
+  for (int i = 0; i < 6; i++) {
+    n.addEmptyRecord();
+  }
+  assertEqual(6, n.getRecordCapacity());
+
+  // spills to the heap past its own capacity
+  n.addEmptyRecord();
+  assertEqual(7, n.getRecordCount());
+  assertTrue(n.getRecordCapacity() > 6);
+
+  // a heap table moves as is, leaving the inline table behind
+  NdefMessage moved = static_cast<NdefMessageBase&&>(n);
+  assertEqual(7, moved.getRecordCount());
+  assertEqual(6, n.getRecordCapacity());
+
+  NdefMessageN<8> copy = moved;
+  assertEqual(7, copy.getRecordCount());
+  assertEqual(8, copy.getRecordCapacity());
+
+  uint8_t encoded[] = { 0x90, 0x00, 0x00, 0x10, 0x00, 0x00, 0x50, 0x00, 0x00 };
+  NdefMessageN<3> decoded = NdefMessageN<3>(encoded, sizeof(encoded));
+  assertEqual(3, decoded.getRecordCount());
+  assertEqual(3, decoded.getRecordCapacity());
+
+  // a message carries only its own records
+  assertTrue(sizeof(NdefMessageN<1>) < sizeof(NdefMessage));
+  assertEqual(sizeof(NdefMessageN<2>) - sizeof(NdefMessageN<1>), sizeof(NdefRecord));
+}
+
+test(callerArenaKeepsInlineRecords)
+{
+  uint8_t arena[8];
+  NdefMessage m = NdefMessage();
+  m.setArena(arena, sizeof(arena));
+  for (int i = 0; i < NDEF_INLINE_RECORDS; i++) {
+    assertTrue(m.emplaceRecord(TNF_EMPTY, NULL, 0, NULL, 0));
+  }
+  // the record table would have to go on the heap
+  assertFalse(m.emplaceRecord(TNF_EMPTY, NULL, 0, NULL, 0));
+  assertEqual(NDEF_INLINE_RECORDS, m.getRecordCount());
+
+  // as many records as before the table could grow
+  uint8_t bigger[64];
+  NdefMessage texts = NdefMessage();
+  texts.setArena(bigger, sizeof(bigger));
+  for (int i = 0; i < 4; i++) {
+    assertTrue(texts.addTextRecord("foo"));
+  }
+}
+
+test(moveMessageN)
+{
+  NdefMessageN<4> a = NdefMessageN<4>();
+  a.addTextRecord("foo");
+  a.addTextRecord("bar");
+  const byte *payload = a[1].getPayload();
+
+  // moves, rather than copying through the copy constructor
+  NdefMessageN<4> b(static_cast<NdefMessageN<4>&&>(a));
+  assertEqual(0, a.getRecordCount());
+  assertEqual(2, b.getRecordCount());
+  assertTrue(payload == b[1].getPayload());
+
+  NdefMessageN<4> c = NdefMessageN<4>();
+  c.addEmptyRecord();
+  c = static_cast<NdefMessageN<4>&&>(b);
+  assertEqual(0, b.getRecordCount());
+  assertEqual(2, c.getRecordCount());
+  assertTrue(payload == c[1].getPayload());
+}
+
+// collects chunks end to end, checking they arrive in order
+class ChunkCollector : public NdefChunkedSink
+{
+  public:
+    ChunkCollector(byte *staging, unsigned int size, byte *out)
+      : NdefChunkedSink(staging, size), out(out), chunks(0), inOrder(true), next(0) {}
+    byte *out;
+    int chunks;
+    bool inOrder;
+  protected:
+    boolean writeChunk(unsigned long offset, const byte *data, unsigned int length)
+    {
+      inOrder = inOrder && offset == next;
+      memcpy(&out[offset], data, length);
+      next = offset + length;
+      chunks++;
+      return true;
+    }
+  private:
+    unsigned long next;
+};
+
+test(encodeReturnsSize)
+{
+  NdefMessage m = NdefMessage();
+  m.addTextRecord("hello, world");
+  m.addUriRecord("http://arduino.cc");
+  int size = m.getEncodedSize();
+
+  uint8_t encoded[size];
+  assertEqual(size, m.encode(encoded));
+
+  // the sink gets the same bytes
+  uint8_t buffer[size];
+  NdefBufferSink sink(buffer, sizeof(buffer));
+  assertEqual(size, m.encode(sink));
+  assertEqual(size, sink.getLength());
+  assertBytesEqual(encoded, buffer, size);
+
+  // a sink that is too small stops the encoder
+  NdefBufferSink small(buffer, size - 1);
+  assertEqual(0, m.encode(small));
+}
+
+test(encodeInChunks)
+{
+  NdefMessage m = NdefMessage();
+  m.addTextRecord("The quick brown fox jumps over the lazy dog");
+  m.addEmptyRecord();
+  int size = m.getEncodedSize();
+  uint8_t encoded[size];
+  m.encode(encoded);
+
+  for (unsigned int chunk = 1; chunk <= 16; chunk++) {
+    uint8_t staging[16];
+    uint8_t out[size];
+    ChunkCollector sink(staging, chunk, out);
+    assertEqual(size, m.encode(sink));
+    assertTrue(sink.flush());
+    assertEqual((unsigned long)size, sink.getBytesWritten());
+    assertTrue(sink.inOrder);
+    assertEqual((size + chunk - 1) / chunk, sink.chunks);
+    assertBytesEqual(encoded, out, size);
+  }
+}
+
+test(encodedSizeKept)
+{
+  NdefMessage m = NdefMessage();
+  assertEqual(0, m.getEncodedSize());
+  m.addEmptyRecord();
+  assertEqual(3, m.getEncodedSize());
+
+  // 300 payload bytes in chunks of 200 and 100 become one long record
+  uint8_t encoded[3 + 200 + 3 + 100];
+  memset(encoded, 0x61, sizeof(encoded));
+  encoded[0] = 0xB5; encoded[1] = 0x00; encoded[2] = 200;
+  encoded[203] = 0x56; encoded[204] = 0x00; encoded[205] = 100;
+  assertEqual(NDEF_OK, m.decode(encoded, sizeof(encoded)));
+  assertEqual(300, m[0].getPayloadLength());
+  assertEqual(2 + 4 + 300, m.getEncodedSize());
+  assertEqual(m[0].getEncodedSize(), m.getEncodedSize());
+
+  NdefMessage moved = static_cast<NdefMessage&&>(m);
+  assertEqual(0, m.getEncodedSize());
+  assertEqual(306, moved.getEncodedSize());
+  NdefMessage copy = moved;
+  assertEqual(306, copy.getEncodedSize());
+}
+
+test(buildersMatchStringVersions)
+{
+  NdefMessage strings = NdefMessage();
+  strings.addTextRecord(String("hello"), String("en-US"));
+  strings.addUriRecord(String("http://arduino.cc"));
+  strings.addMimeMediaRecord(String("text/plain"), String("foo"));
+
+  NdefMessage builders = NdefMessage();
+  assertTrue(builders.addTextRecord("hello", "en-US"));
+  assertTrue(builders.addUriRecord("http://arduino.cc"));
+  assertTrue(builders.addMimeMediaRecord("text/plain", "foo"));
+
+  assertEqual(strings.getEncodedSize(), builders.getEncodedSize());
+  uint8_t expected[strings.getEncodedSize()];
+  uint8_t actual[builders.getEncodedSize()];
+  strings.encode(expected);
+  builders.encode(actual);
+  assertBytesEqual(expected, actual, sizeof(expected));
+
+  uint8_t text[] = { 0x05, 0x65, 0x6E, 0x2D, 0x55, 0x53, 0x68, 0x65, 0x6C, 0x6C, 0x6F };
+  assertEqual((int)sizeof(text), builders[0].getPayloadLength());
+  assertBytesEqual(text, builders[0].getPayload(), sizeof(text));
+}
+
+test(buildersFromSpans)
+{
+  // neither is NUL terminated
+  const char buffer[] = { 'f', 'r', 'b', 'o', 'n', 'j', 'o', 'u', 'r' };
+  NdefSpan language = { (const byte *)buffer, 2 };
+  NdefSpan text = { (const byte *)&buffer[2], 7 };
+  NdefSpan uri = { (const byte *)&buffer[2], 3 };
+
+  NdefMessage m = NdefMessage();
+  assertTrue(m.addTextRecord(text, language));
+  assertTrue(m.addUriRecord(uri));
+  // the record fields and nothing else went into the arena
+  assertEqual(1 + 1 + 2 + 7 + 1 + 1 + 3, m.getArenaUsed());
+
+  uint8_t textPayload[] = { 0x02, 'f', 'r', 'b', 'o', 'n', 'j', 'o', 'u', 'r' };
+  uint8_t uriPayload[] = { 0x00, 'b', 'o', 'n' };
+  assertBytesEqual(textPayload, m[0].getPayload(), sizeof(textPayload));
+  assertBytesEqual(uriPayload, m[1].getPayload(), sizeof(uriPayload));
+
+  // the status byte has 6 bits for the language length
+  NdefSpan tooLong = { (const byte *)buffer, 64 };
+  assertFalse(m.addTextRecord(text, tooLong));
+  assertEqual(2, m.getRecordCount());
+}
+
+test(buildersIntoCallerArena)
+{
+  uint8_t arena[12];
+  NdefMessage m = NdefMessage();
+  m.setArena(arena, sizeof(arena));
+  // 1 type byte, status, "en" and "foo"
+  assertTrue(m.addTextRecord("foo"));
+  assertEqual(7, m.getArenaUsed());
+  // 1 type byte, identifier code and 5 bytes do not fit in what is left
+  assertFalse(m.addUriRecord("a.com"));
+  assertEqual(1, m.getRecordCount());
+  assertEqual(7, m.getArenaUsed());
+}
+
 test(aaa_printFreeMemoryAtStart)  //  warning: relies on fact tests are run in alphabetical order
 {
   Serial.println(F("---------------------"));
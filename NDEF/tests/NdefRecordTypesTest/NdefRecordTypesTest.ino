@@ -0,0 +1,161 @@
+#include <Wire.h>
+#include <PN532.h>
+#include <NdefMessage.h>
+#include <NdefRecordTypes.h>
+#include <ArduinoUnit.h>
+
+// Custom Assertion
+void assertSpanEqual(const char* expected, NdefSpan actual)
+{
+  assertEqual(strlen(expected), actual.length);
+  assertTrue(actual.equals(expected));
+}
+
+// a smart poster with a uri and titles in two languages
+void addSmartPoster(NdefMessage& message)
+{
+  NdefMessage poster = NdefMessage();
+  poster.addTextRecord("Arduino", "en");
+  poster.addUriRecord("https://www.arduino.cc");
+  poster.addTextRecord("Arduino FR", "fr");
+  uint8_t encoded[poster.getEncodedSize()];
+  poster.encode(encoded);
+
+  const byte type[] = { 'S', 'p' };
+  message.emplaceRecord(TNF_WELL_KNOWN, type, sizeof(type), encoded, sizeof(encoded));
+}
+
+void setup() {
+  Serial.begin(9600);
+}
+
+test(text)
+{
+  NdefMessage m = NdefMessage();
+  m.addTextRecord("hello", "en-US");
+
+  NdefTextRecord text(m[0]);
+  assertTrue(text.isValid());
+  assertFalse(text.isUtf16());
+  assertSpanEqual("en-US", text.getLanguage());
+  assertSpanEqual("hello", text.getText());
+  // read in place
+  assertTrue(text.getText().data == m[0].getPayload() + 6);
+
+  uint8_t utf16[] = { 0xD1, 0x01, 0x05, 0x54, 0x82, 0x65, 0x6E, 0x00, 0x61 };
+  NdefRecordView view(utf16, sizeof(utf16));
+  NdefTextRecord wide(view);
+  assertTrue(wide.isValid());
+  assertTrue(wide.isUtf16());
+  assertEqual(2, wide.getText().length);
+}
+
+test(textMalformed)
+{
+  // the status byte announces more language than there is payload
+  uint8_t shortLanguage[] = { 0xD1, 0x01, 0x02, 0x54, 0x05, 0x65 };
+  NdefTextRecord text = NdefTextRecord(NdefRecordView(shortLanguage, sizeof(shortLanguage)));
+  assertFalse(text.isValid());
+  assertTrue(text.getText().isEmpty());
+
+  uint8_t noStatus[] = { 0xD1, 0x01, 0x00, 0x54 };
+  assertFalse(NdefTextRecord(NdefRecordView(noStatus, sizeof(noStatus))).isValid());
+
+  NdefMessage m = NdefMessage();
+  m.addUriRecord("http://arduino.cc");
+  assertFalse(NdefTextRecord(m[0]).isValid());
+}
+
+test(uri)
+{
+  NdefMessage m = NdefMessage();
+  m.addUriRecord("https://www.arduino.cc");
+
+  NdefUriRecord uri(m[0]);
+  assertTrue(uri.isValid());
+  assertEqual(NDEF_URIPREFIX_HTTPS_WWWDOT, uri.getPrefixCode());
+  assertSpanEqual("arduino.cc", uri.getRemainder());
+  assertTrue(uri.getRemainder().data == m[0].getPayload() + 1);
+  assertEqual(22, uri.getLength());
+
+  char full[32];
+  assertEqual(22, uri.getUri(full, sizeof(full)));
+  assertEqual(0, strcmp("https://www.arduino.cc", full));
+
+  uint8_t noCode[] = { 0xD1, 0x01, 0x00, 0x55 };
+  NdefUriRecord empty = NdefUriRecord(NdefRecordView(noCode, sizeof(noCode)));
+  assertFalse(empty.isValid());
+  assertEqual(0, empty.getLength());
+}
+
+test(mime)
+{
+  NdefMessage m = NdefMessage();
+  m.addMimeMediaRecord("text/plain", "foo");
+  m.addTextRecord("foo");
+
+  NdefMimeRecord mime(m[0]);
+  assertTrue(mime.isValid());
+  assertSpanEqual("text/plain", mime.getMimeType());
+  assertSpanEqual("foo", mime.getData());
+  assertFalse(NdefMimeRecord(m[1]).isValid());
+}
+
+test(smartPoster)
+{
+  NdefMessage m = NdefMessage();
+  addSmartPoster(m);
+
+  NdefSmartPoster poster(m[0]);
+  assertTrue(poster.isValid());
+  assertEqual(3, poster.getMessage().getRecordCount());
+
+  NdefUriRecord uri = poster.getUri();
+  assertTrue(uri.isValid());
+  assertSpanEqual("arduino.cc", uri.getRemainder());
+
+  assertSpanEqual("Arduino", poster.getTitle().getText());
+  assertSpanEqual("Arduino FR", poster.getTitle("fr").getText());
+  // no title in German, fall back to the first
+  assertSpanEqual("Arduino", poster.getTitle("de").getText());
+}
+
+test(smartPosterFromView)
+{
+  NdefMessage m = NdefMessage();
+  m.addTextRecord("before");
+  addSmartPoster(m);
+  uint8_t encoded[m.getEncodedSize()];
+  m.encode(encoded);
+
+  NdefMessageView view(encoded, sizeof(encoded));
+  NdefSmartPoster poster(view.getRecord(1));
+  assertTrue(poster.isValid());
+  // the nested message points into the outer buffer
+  NdefMessageView nested = poster.getMessage();
+  assertTrue(nested.getData() > encoded);
+  assertTrue(nested.getData() < encoded + sizeof(encoded));
+
+  char full[32];
+  poster.getUri().getUri(full, sizeof(full));
+  assertEqual(0, strcmp("https://www.arduino.cc", full));
+
+  assertFalse(NdefSmartPoster(view.getRecord(0)).isValid());
+}
+
+test(smartPosterWithoutUri)
+{
+  // the nested uri record runs past the end of the poster
+  NdefMessage m = NdefMessage();
+  const byte type[] = { 'S', 'p' };
+  const byte nested[] = { 0xD1, 0x01, 0x05, 0x55 };
+  m.emplaceRecord(TNF_WELL_KNOWN, type, sizeof(type), nested, sizeof(nested));
+  NdefSmartPoster truncated(m[0]);
+  assertTrue(truncated.isValid());
+  assertFalse(truncated.getUri().isValid());
+  assertFalse(truncated.getTitle().isValid());
+}
+
+void loop() {
+  Test::run();
+}
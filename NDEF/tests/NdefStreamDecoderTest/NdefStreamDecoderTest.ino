@@ -0,0 +1,199 @@
+#include <Wire.h>
+#include <PN532.h>
+#include <NdefMessage.h>
+#include <NdefStreamDecoder.h>
+#include <ArduinoUnit.h>
+
+// text "en" "foo", then "arduino.cc" as a uri split over three chunks
+uint8_t encoded[] = {
+  0x91, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F,
+  0x39, 0x01, 0x04, 0x01, 0x55, 0x69, 0x00, 0x61, 0x72, 0x64,
+  0x36, 0x00, 0x04, 0x75, 0x69, 0x6E, 0x6F,
+  0x56, 0x00, 0x03, 0x2E, 0x63, 0x63
+};
+uint8_t uri[] = { 0x00, 0x61, 0x72, 0x64, 0x75, 0x69, 0x6E, 0x6F, 0x2E, 0x63, 0x63 };
+
+// counts what it is handed, keeps nothing but a checksum
+class CountingSink : public NdefPayloadSink
+{
+  public:
+    CountingSink() : records(0), ends(0), payloadBytes(0), pieces(0), sum(0) {}
+    void beginRecord(byte tnf, const byte *type, unsigned int typeLength,
+                     const byte *id, unsigned int idLength)
+    {
+      records++;
+      lastTnf = tnf;
+      lastType = typeLength ? type[0] : 0;
+      lastIdLength = idLength;
+    }
+    void payload(const byte *data, unsigned int length)
+    {
+      pieces++;
+      payloadBytes += length;
+      for (unsigned int i = 0; i < length; i++) {
+        sum += data[i];
+      }
+    }
+    void endRecord()
+    {
+      ends++;
+    }
+    int records;
+    int ends;
+    unsigned long payloadBytes;
+    int pieces;
+    unsigned long sum;
+    byte lastTnf;
+    byte lastType;
+    unsigned int lastIdLength;
+};
+
+void assertUriRecord(const NdefMessage& m)
+{
+  assertEqual(2, m.getRecordCount());
+  const NdefRecord& r = m[1];
+  assertEqual(TNF_WELL_KNOWN, r.getTnf());
+  byte type[1];
+  r.getType(type);
+  assertEqual('U', type[0]);
+  assertEqual(1, r.getIdLength());
+  assertEqual((int)sizeof(uri), r.getPayloadLength());
+  for (unsigned int i = 0; i < sizeof(uri); i++) {
+    assertEqual(uri[i], r.getPayload()[i]);
+  }
+}
+
+void setup() {
+  Serial.begin(9600);
+}
+
+test(wholeBuffer)
+{
+  NdefMessage m = NdefMessage();
+  NdefStreamDecoder decoder(m);
+  assertEqual(NDEF_OK, decoder.write(encoded, sizeof(encoded)));
+  assertTrue(decoder.isComplete());
+  assertEqual(NDEF_OK, decoder.finish());
+  assertEqual((unsigned long)sizeof(encoded), decoder.getBytesRead());
+  assertUriRecord(m);
+}
+
+test(everySplit)
+{
+  // same records however the bytes are cut up
+  for (unsigned int piece = 1; piece <= 8; piece++) {
+    NdefMessage m = NdefMessage();
+    NdefStreamDecoder decoder(m);
+    for (unsigned int i = 0; i < sizeof(encoded); i += piece) {
+      unsigned int n = sizeof(encoded) - i < piece ? sizeof(encoded) - i : piece;
+      assertEqual(NDEF_OK, decoder.write(&encoded[i], n));
+    }
+    assertEqual(NDEF_OK, decoder.finish());
+    assertUriRecord(m);
+  }
+}
+
+test(matchesDecode)
+{
+  NdefMessage decoded = NdefMessage();
+  assertEqual(NDEF_OK, decoded.decode(encoded, sizeof(encoded)));
+  assertUriRecord(decoded);
+}
+
+test(sinkJoinsChunks)
+{
+  CountingSink sink;
+  NdefStreamDecoder decoder(sink);
+  for (unsigned int i = 0; i < sizeof(encoded); i++) {
+    assertEqual(NDEF_OK, decoder.write(&encoded[i], 1));
+  }
+  assertEqual(NDEF_OK, decoder.finish());
+
+  assertEqual(2, sink.records);
+  assertEqual(2, sink.ends);
+  assertEqual(6 + (unsigned long)sizeof(uri), sink.payloadBytes);
+  assertEqual('U', sink.lastType);
+  assertEqual(1, sink.lastIdLength);
+
+  unsigned long sum = 0x02 + 0x65 + 0x6E + 0x66 + 0x6F + 0x6F;
+  for (unsigned int i = 0; i < sizeof(uri); i++) {
+    sum += uri[i];
+  }
+  assertEqual(sum, sink.sum);
+}
+
+test(sinkLargePayload)
+{
+  // a 64 kB mime record in long record form, fed a page at a time, never held in memory
+  unsigned long length = 65536;
+  uint8_t header[] = { 0xC2, 0x01, 0x00, 0x01, 0x00, 0x00, 0x78 };
+  uint8_t page[16];
+  memset(page, 0x01, sizeof(page));
+
+  CountingSink sink;
+  NdefStreamDecoder decoder(sink);
+  assertEqual(NDEF_OK, decoder.write(header, sizeof(header)));
+  for (unsigned long i = 0; i < length; i += sizeof(page)) {
+    decoder.write(page, sizeof(page));
+  }
+  assertEqual(NDEF_OK, decoder.finish());
+  assertEqual(1, sink.records);
+  assertEqual(length, sink.payloadBytes);
+  assertEqual(length, sink.sum);
+  assertEqual(TNF_MIME_MEDIA, sink.lastTnf);
+}
+
+test(errors)
+{
+  NdefMessage m = NdefMessage();
+  NdefStreamDecoder decoder(m);
+  assertEqual(NDEF_ERROR_EMPTY, decoder.finish());
+
+  // the stream stops inside the second chunk
+  decoder.reset();
+  assertEqual(NDEF_OK, decoder.write(encoded, 22));
+  assertEqual(2, m.getRecordCount());
+  assertEqual(NDEF_ERROR_TRUNCATED, decoder.finish());
+  assertEqual(0, m.getRecordCount());
+
+  // and between records
+  decoder.reset();
+  decoder.write(encoded, 10);
+  assertEqual(NDEF_ERROR_MESSAGE_END, decoder.finish());
+
+  // a bad header is reported as soon as its lengths are in, and sticks
+  uint8_t reserved[] = { 0xD7, 0x00, 0x00 };
+  decoder.reset();
+  assertEqual(NDEF_ERROR_TNF, decoder.write(reserved, sizeof(reserved)));
+  assertEqual(NDEF_ERROR_TNF, decoder.write(encoded, sizeof(encoded)));
+  assertEqual(0, m.getRecordCount());
+
+  // the message ends on a chunk
+  uint8_t openChunk[] = { 0xF1, 0x01, 0x00, 0x54 };
+  decoder.reset();
+  assertEqual(NDEF_ERROR_CHUNK, decoder.write(openChunk, sizeof(openChunk)));
+
+  // a type longer than the decoder keeps
+  uint8_t longType[] = { 0xD2, NDEF_STREAM_FIELD_BYTES + 1, 0x00 };
+  decoder.reset();
+  assertEqual(NDEF_ERROR_NO_MEMORY, decoder.write(longType, sizeof(longType)));
+}
+
+test(trailingBytesIgnored)
+{
+  uint8_t padded[sizeof(encoded) + 2];
+  memcpy(padded, encoded, sizeof(encoded));
+  padded[sizeof(encoded)] = 0xFE;
+  padded[sizeof(encoded) + 1] = 0x00;
+
+  NdefMessage m = NdefMessage();
+  NdefStreamDecoder decoder(m);
+  assertEqual(NDEF_OK, decoder.write(padded, sizeof(padded)));
+  assertEqual(NDEF_OK, decoder.finish());
+  assertEqual((unsigned long)sizeof(encoded), decoder.getBytesRead());
+  assertUriRecord(m);
+}
+
+void loop() {
+  Test::run();
+}
@@ -1,6 +1,9 @@
 #include <Wire.h>
 #include <PN532.h>
 #include <NdefRecord.h>
+#include <NdefMessage.h>
+#include <NdefView.h>
+#include <NdefStreamDecoder.h>
 #include <ArduinoUnit.h>
 
 void assertBytesEqual(const uint8_t* expected, const uint8_t* actual, uint8_t size) {
@@ -168,6 +171,66 @@ test(encoding_with_record_id) {
   assertBytesEqual(encodedBytes, expectedBytes, sizeof(encodedBytes));
 }
 
+test(encoding_long_record) {
+  NdefRecord record = NdefRecord();
+  record.setTnf(TNF_UNKNOWN);
+  uint8_t payload[300];
+  memset(payload, 0x61, sizeof(payload));
+  record.setPayload(payload, sizeof(payload));
+  assertEqual(2 + 4 + 300, record.getEncodedSize());
+
+  uint8_t encodedBytes[record.getEncodedSize()];
+  assertEqual(sizeof(encodedBytes), record.encode(encodedBytes, true, true));
+  uint8_t expectedHeader[] = { 0xC5, 0x00, 0x00, 0x00, 0x01, 0x2C };
+  assertBytesEqual(encodedBytes, expectedHeader, sizeof(expectedHeader));
+}
+
+#if !defined(__AVR__)
+// a payload past 64 kB needs all four length bytes, too big for an Uno
+test(large_payload_round_trip) {
+  const uint32_t length = 100000; // 0x000186A0
+  uint8_t *payload = (uint8_t *)malloc(length);
+  for (uint32_t i = 0; i < length; i++) {
+    payload[i] = i * 7;
+  }
+
+  NdefMessage message = NdefMessage();
+  message.addMimeMediaRecord("application/octet-stream", payload, length);
+  uint32_t size = message.getEncodedSize();
+  assertEqual(2 + 4 + 24 + length, size);
+
+  uint8_t *encoded = (uint8_t *)malloc(size);
+  assertEqual(size, message.encode(encoded));
+  uint8_t expectedHeader[] = { 0xC2, 24, 0x00, 0x01, 0x86, 0xA0 };
+  assertBytesEqual(encoded, expectedHeader, sizeof(expectedHeader));
+
+  NdefMessage decoded = NdefMessage();
+  assertEqual(NDEF_OK, decoded.decode(encoded, size));
+  assertEqual(length, decoded[0].getPayloadLength());
+  assertEqual(0, memcmp(payload, decoded[0].getPayload(), length));
+  assertEqual(size, decoded.getEncodedSize());
+
+  NdefRecordView view(encoded, size);
+  assertTrue(view.isValid());
+  assertEqual(length, view.getPayloadLength());
+
+  NdefMessage streamed = NdefMessage();
+  NdefStreamDecoder decoder(streamed);
+  for (uint32_t i = 0; i < size; i += 4096) {
+    decoder.write(&encoded[i], size - i < 4096 ? size - i : 4096);
+  }
+  assertEqual(NDEF_OK, decoder.finish());
+  assertEqual(length, streamed[0].getPayloadLength());
+  assertEqual(0, memcmp(payload, streamed[0].getPayload(), length));
+
+  // one byte short of the length in the header
+  assertEqual(NDEF_ERROR_TRUNCATED, decoded.decode(encoded, size - 1));
+
+  free(encoded);
+  free(payload);
+}
+#endif
+
 void loop() {
   Test::run();
 }
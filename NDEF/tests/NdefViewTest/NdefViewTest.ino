@@ -0,0 +1,97 @@
+#include <Wire.h>
+#include <PN532.h>
+#include <NdefMessage.h>
+#include <NdefView.h>
+#include <ArduinoUnit.h>
+
+// text "en" "foo", uri "arduino.cc", mime "text/plain" with id "a"
+uint8_t encoded[] = {
+  0x91, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F,
+  0x11, 0x01, 0x0B, 0x55, 0x00, 0x61, 0x72, 0x64, 0x75, 0x69, 0x6E, 0x6F, 0x2E, 0x63, 0x63,
+  0x5A, 0x0A, 0x02, 0x01, 0x74, 0x65, 0x78, 0x74, 0x2F, 0x70, 0x6C, 0x61, 0x69, 0x6E, 0x61, 0x68, 0x69
+};
+
+void setup() {
+  Serial.begin(9600);
+}
+
+test(iterate)
+{
+  NdefMessageView view(encoded, sizeof(encoded));
+  assertEqual(3, view.getRecordCount());
+
+  unsigned int i = 0;
+  for (const NdefRecordView& record : view)
+  {
+    assertTrue(record.isValid());
+    assertEqual(i == 0, record.isMessageBegin());
+    assertEqual(i == 2, record.isMessageEnd());
+    assertTrue(record.isShortRecord());
+    assertFalse(record.isChunked());
+    i++;
+  }
+  assertEqual(3, i);
+}
+
+test(spans)
+{
+  NdefMessageView view(encoded, sizeof(encoded));
+
+  NdefRecordView text = view.getRecord(0);
+  assertEqual(TNF_WELL_KNOWN, text.getTnf());
+  assertTrue(text.getTypeSpan().equals("T"));
+  assertTrue(text.getIdSpan().isEmpty());
+  assertEqual(6, text.getPayloadSpan().length);
+  // spans point into the buffer
+  assertTrue(text.getPayloadSpan().data == &encoded[4]);
+
+  NdefRecordView mime = view.getRecord(2);
+  assertEqual(TNF_MIME_MEDIA, mime.getTnf());
+  assertTrue(mime.hasId());
+  assertTrue(mime.getTypeSpan().equals("text/plain"));
+  assertTrue(mime.getIdSpan().equals("a"));
+  assertTrue(mime.getPayloadSpan().equals("hi"));
+  assertFalse(mime.getPayloadSpan().equals("hi!"));
+}
+
+test(longRecord)
+{
+  // same text record without the short record flag
+  uint8_t data[] = { 0xC1, 0x01, 0x00, 0x00, 0x00, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F };
+  NdefRecordView record(data, sizeof(data));
+  assertTrue(record.isValid());
+  assertFalse(record.isShortRecord());
+  assertEqual(6, record.getPayloadLength());
+  assertEqual((int)sizeof(data), record.getEncodedSize());
+}
+
+test(truncated)
+{
+  // the uri record is cut short, iteration stops after the text record
+  NdefMessageView view(encoded, 20);
+  assertEqual(1, view.getRecordCount());
+  assertFalse(view.getRecord(1).isValid());
+  assertFalse(NdefRecordView(encoded, 1).isValid());
+  assertEqual(0, NdefMessageView(encoded, 0).getRecordCount());
+}
+
+test(findUriWithoutAllocating)
+{
+  int start = freeMemory();
+  NdefSpan uri = { NULL, 0 };
+  for (const NdefRecordView& record : NdefMessageView(encoded, sizeof(encoded)))
+  {
+    if (record.getTnf() == TNF_WELL_KNOWN && record.getTypeSpan().equals("U"))
+    {
+      uri = record.getPayloadSpan();
+      break;
+    }
+  }
+  assertEqual(0, (start - freeMemory()));
+  assertEqual(11, uri.length);
+  assertEqual(0x00, uri.data[0]);
+}
+
+void loop() {
+  Test::run();
+}
@@ -31,6 +31,50 @@ test(getUid)
   assertEqual(0x17, uid[3]);
 }
 
+test(copyOwnsMessage)
+{
+  byte uid[4] = { 0x00, 0xFF, 0xAA, 0x17 };
+  uint8_t encoded[] = { 0xD1, 0x01, 0x06, 0x54, 0x02, 0x65, 0x6E, 0x66, 0x6F, 0x6F };
+
+  NfcTag copy;
+  if (true) // the original goes out of scope first
+  {
+    NfcTag tag = NfcTag(uid, sizeof(uid), "NFC Forum Type 2", encoded, sizeof(encoded));
+    copy = tag;
+    NfcTag constructed = tag;
+    assertEqual(1, constructed.getNdefMessage().getRecordCount());
+  }
+  assertTrue(copy.hasNdefMessage());
+  assertEqual(6, copy.getNdefMessage().getRecord(0).getPayloadLength());
+}
+
+test(moveMessageIntoTag)
+{
+  byte uid[4] = { 0x00, 0xFF, 0xAA, 0x17 };
+  NdefMessage message = NdefMessage();
+  message.addTextRecord("foo");
+  const byte *payload = message.getRecord(0).getPayload();
+
+  NfcTag tag = NfcTag(uid, sizeof(uid), "NFC Forum Type 2", static_cast<NdefMessage&&>(message));
+  assertEqual(0, message.getRecordCount());
+
+  // same bytes, not a copy
+  const NdefRecord& record = tag.getNdefMessage().getRecord(0);
+  assertTrue(payload == record.getPayload());
+
+  NfcTag moved = static_cast<NfcTag&&>(tag);
+  assertFalse(tag.hasNdefMessage());
+  assertTrue(payload == moved.getNdefMessage()[0].getPayload());
+}
+
+test(noMessage)
+{
+  byte uid[4] = { 0x00, 0xFF, 0xAA, 0x17 };
+  NfcTag tag = NfcTag(uid, sizeof(uid));
+  assertFalse(tag.hasNdefMessage());
+  assertEqual(0, tag.getNdefMessage().getRecordCount());
+}
+
 void loop() {
   Test::run();
 }
@@ -0,0 +1,194 @@
+#ifndef CRC_ENGINE_H
+#define CRC_ENGINE_H
+
+/*
+ * Header-only CRC-16 engine, parameterised at compile time.
+ *
+ *   Poly    generator polynomial in normal form, e.g. 0x1021
+ *   Init    starting register value.  For reflected CRCs this is the
+ *           register as crcsum() sees it, e.g. 0x6363 for CRC_A
+ *   Reflect true for LSB-first CRCs (ISO 14443, X.25)
+ *   XorOut  xored into the register to give the checksum
+ *
+ * The 256-entry table is built by the compiler (in flash on AVR) and
+ * compute() folds constant byte lists into a constant:
+ *
+ *   uint16_t crc = CrcIso14443A::checksum(frame, len);
+ *   CrcIso14443A::append(frame, len);          // LSB first
+ *   static_assert(CrcIso14443A::compute(0x02, 0x00, 0xA4) == ..., "");
+ *
+ * Unlike crcverify/crcappend in crc16.h, which always start from 0xFFFF,
+ * each typedef below carries the right seed for its protocol.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#define CRC_ENGINE_PROGMEM PROGMEM
+#define CRC_ENGINE_READ(addr) pgm_read_word(addr)
+#else
+#define CRC_ENGINE_PROGMEM
+#define CRC_ENGINE_READ(addr) (*(addr))
+#endif
+
+//==============================================================================
+// 0, 1, ... N-1 as a parameter pack, to expand the table initialiser
+
+template <unsigned... I>
+struct CrcIndices {};
+
+template <unsigned N, unsigned... I>
+struct CrcMakeIndices : CrcMakeIndices<N - 1, N - 1, I...> {};
+
+template <unsigned... I>
+struct CrcMakeIndices<0, I...>
+{
+    typedef CrcIndices<I...> type;
+};
+
+template <typename Engine, typename Indices>
+struct CrcTable;
+
+template <typename Engine, unsigned... I>
+struct CrcTable<Engine, CrcIndices<I...> >
+{
+    static const uint16_t values[sizeof...(I)];
+};
+
+template <typename Engine, unsigned... I>
+const uint16_t CrcTable<Engine, CrcIndices<I...> >::values[sizeof...(I)] CRC_ENGINE_PROGMEM =
+{
+    Engine::tableEntry(I)...
+};
+
+//==============================================================================
+template <uint16_t Poly, uint16_t Init, bool Reflect, uint16_t XorOut>
+class CrcEngine
+{
+public:
+    static constexpr uint16_t polynomial = Poly;
+    static constexpr uint16_t init = Init;
+    static constexpr bool reflect = Reflect;
+    static constexpr uint16_t xorOut = XorOut;
+
+    /** Bit-reverse a 16 bit value */
+    static constexpr uint16_t reflect16(uint16_t value, uint8_t bits = 16, uint16_t result = 0)
+    {
+        return bits == 0 ? result : reflect16(value >> 1, bits - 1, (result << 1) | (value & 1));
+    }
+
+    /** Table entry i, computed a bit at a time */
+    static constexpr uint16_t tableEntry(unsigned i)
+    {
+        return Reflect ? reflectedBits(i, 8) : normalBits(i << 8, 8);
+    }
+
+    /** Register after one byte, without the table (usable in constant expressions) */
+    static constexpr uint16_t step(uint16_t crc, uint8_t value)
+    {
+        return Reflect
+            ? reflectedBits(crc ^ value, 8)
+            : normalBits(crc ^ (uint16_t)(value << 8), 8);
+    }
+
+    /** Checksum of a list of constant bytes, folded at compile time */
+    template <typename... Bytes>
+    static constexpr uint16_t compute(Bytes... bytes)
+    {
+        return computeFrom(Init, bytes...) ^ XorOut;
+    }
+
+    /** Raw register update, e.g. to continue across several buffers */
+    static uint16_t update(uint16_t crc, const uint8_t* data, size_t length)
+    {
+        const uint16_t* table = CrcTable<CrcEngine, typename CrcMakeIndices<256>::type>::values;
+        while (length--)
+        {
+            if (Reflect)
+            {
+                crc = (crc >> 8) ^ CRC_ENGINE_READ(&table[(crc ^ *data++) & 0xff]);
+            }
+            else
+            {
+                crc = (crc << 8) ^ CRC_ENGINE_READ(&table[((crc >> 8) ^ *data++) & 0xff]);
+            }
+        }
+        return crc;
+    }
+
+    static uint16_t checksum(const uint8_t* data, size_t length)
+    {
+        return update(Init, data, length) ^ XorOut;
+    }
+
+    /** Append the checksum in transmission order. Room for two bytes is needed. */
+    static void append(uint8_t* data, size_t length)
+    {
+        uint16_t crc = checksum(data, length);
+        if (Reflect)
+        {
+            data[length] = crc & 0xff;
+            data[length + 1] = crc >> 8;
+        }
+        else
+        {
+            data[length] = crc >> 8;
+            data[length + 1] = crc & 0xff;
+        }
+    }
+
+    /** True if the last two bytes of frame are its checksum */
+    static bool verify(const uint8_t* frame, size_t length)
+    {
+        if (length < 2)
+        {
+            return false;
+        }
+        uint16_t crc = checksum(frame, length - 2);
+        if (Reflect)
+        {
+            return frame[length - 2] == (crc & 0xff) && frame[length - 1] == (crc >> 8);
+        }
+        return frame[length - 2] == (crc >> 8) && frame[length - 1] == (crc & 0xff);
+    }
+
+private:
+    static constexpr uint16_t reflectedPoly = reflect16(Poly);
+
+    static constexpr uint16_t reflectedBits(uint16_t crc, uint8_t bits)
+    {
+        return bits == 0 ? crc : reflectedBits((crc & 1) ? (crc >> 1) ^ reflectedPoly : (crc >> 1), bits - 1);
+    }
+
+    static constexpr uint16_t normalBits(uint16_t crc, uint8_t bits)
+    {
+        return bits == 0 ? crc : normalBits((crc & 0x8000) ? (uint16_t)(crc << 1) ^ Poly : (uint16_t)(crc << 1), bits - 1);
+    }
+
+    static constexpr uint16_t computeFrom(uint16_t crc)
+    {
+        return crc;
+    }
+
+    template <typename... Bytes>
+    static constexpr uint16_t computeFrom(uint16_t crc, uint8_t first, Bytes... rest)
+    {
+        return computeFrom(step(crc, first), rest...);
+    }
+};
+
+//==============================================================================
+// Protocol CRCs
+
+/** ISO/IEC 14443-3 Type A, also the M24SR I2C frame CRC */
+typedef CrcEngine<0x1021, 0x6363, true, 0x0000> CrcIso14443A;
+/** ISO/IEC 14443-3 Type B */
+typedef CrcEngine<0x1021, 0xFFFF, true, 0xFFFF> CrcIso14443B;
+/** ISO/IEC 13239 / ITU-T X.25 HDLC frame check sequence */
+typedef CrcEngine<0x1021, 0xFFFF, true, 0xFFFF> CrcX25;
+/** JIS X 6319-4 (FeliCa), sent MSB first */
+typedef CrcEngine<0x1021, 0x0000, false, 0x0000> CrcFelica;
+
+#endif
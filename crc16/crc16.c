@@ -4,8 +4,37 @@
  */
 #include "crc16.h"
 
+#ifdef CRC16_HOST
+#include <stdint.h>
+#include <string.h>
+#endif
+#ifdef CRC16_HAVE_CLMUL
+#include <immintrin.h>
+#endif
+#ifdef CRC16_HAVE_THREADS
+#include <pthread.h>
+#endif
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+#define PROGMEM
+#define pgm_read_word(addr) (*(const unsigned short*)(addr))
+#endif
+
+#if CRC16_BACKEND == CRC16_BACKEND_TABLE || \
+  CRC16_BACKEND == CRC16_BACKEND_PROGMEM
+#define CRC16_HAVE_TABLE 1
+#endif
+
+#if CRC16_BACKEND == CRC16_BACKEND_PROGMEM
+#define CRC16_TABLE_SPACE PROGMEM
+#else
+#define CRC16_TABLE_SPACE
+#endif
+
+#ifdef CRC16_HAVE_TABLE
 /* CRC16 Definitions */
-static const unsigned short crc_table[256] = {
+static const unsigned short crc_table[256] CRC16_TABLE_SPACE = {
   0x0000, 0x1189, 0x2312, 0x329b, 0x4624, 0x57ad, 0x6536, 0x74bf,
   0x8c48, 0x9dc1, 0xaf5a, 0xbed3, 0xca6c, 0xdbe5, 0xe97e, 0xf8f7,
   0x1081, 0x0108, 0x3393, 0x221a, 0x56a5, 0x472c, 0x75b7, 0x643e,
@@ -39,15 +68,45 @@ static const unsigned short crc_table[256] = {
   0xf78f, 0xe606, 0xd49d, 0xc514, 0xb1ab, 0xa022, 0x92b9, 0x8330,
   0x7bc7, 0x6a4e, 0x58d5, 0x495c, 0x3de3, 0x2c6a, 0x1ef1, 0x0f78
 };
+#endif /* CRC16_HAVE_TABLE */
+
+#if CRC16_BACKEND == CRC16_BACKEND_NIBBLE
+/* CRC of a single nibble, crc_table reduced to 4 bits */
+static const unsigned short crc_nibble[16] PROGMEM = {
+  0x0000, 0x1081, 0x2102, 0x3183, 0x4204, 0x5285, 0x6306, 0x7387,
+  0x8408, 0x9489, 0xa50a, 0xb58b, 0xc60c, 0xd68d, 0xe70e, 0xf78f
+};
+#endif
 
 /* CRC calculation macros */
 #define CRC_INIT 0xFFFF
+#if CRC16_BACKEND == CRC16_BACKEND_TABLE
 #define CRC(crcval,newchar) crcval = (crcval >> 8) ^ \
 	crc_table[(crcval ^ newchar) & 0x00ff]
+#elif CRC16_BACKEND == CRC16_BACKEND_PROGMEM
+#define CRC(crcval,newchar) crcval = (crcval >> 8) ^ \
+	pgm_read_word(&crc_table[(crcval ^ newchar) & 0x00ff])
+#elif CRC16_BACKEND == CRC16_BACKEND_NIBBLE
+#define CRC(crcval,newchar) do { \
+	crcval = (crcval >> 4) ^ \
+	  pgm_read_word(&crc_nibble[(crcval ^ newchar) & 0x0f]); \
+	crcval = (crcval >> 4) ^ \
+	  pgm_read_word(&crc_nibble[(crcval ^ (newchar >> 4)) & 0x0f]); \
+  } while (0)
+#elif CRC16_BACKEND == CRC16_BACKEND_BITWISE
+#define CRC(crcval,newchar) do { \
+	unsigned char bit; \
+	crcval ^= newchar; \
+	for (bit = 0; bit < 8; bit++) \
+	  crcval = (crcval & 1) ? (crcval >> 1) ^ 0x8408 : (crcval >> 1); \
+  } while (0)
+#else
+#error "unknown CRC16_BACKEND"
+#endif
 
 unsigned short
-crcsum(const unsigned char* message, unsigned long length,
-       unsigned short crc)
+crcsum_bytewise(const unsigned char* message, unsigned long length,
+		unsigned short crc)
 {
   unsigned long i;
 
@@ -58,6 +117,410 @@ crcsum(const unsigned char* message, unsigned long length,
   return crc;
 }
 
+#ifdef CRC16_HOST
+/*
+ * Slice-by-8: crc_slice[k][i] is the CRC of byte i followed by k zero
+ * bytes, so eight message bytes are folded in with eight independent
+ * lookups.  Built at load time (4 KB).
+ */
+static uint16_t crc_slice[8][256];
+
+static unsigned short
+crc_byte(unsigned char c)
+{
+  unsigned short crc = 0;
+
+  CRC(crc, c);
+  return crc;
+}
+
+static void
+crc_slice_init(void)
+{
+  int i, k;
+
+  for (i = 0; i < 256; i++)
+    crc_slice[0][i] = crc_byte((unsigned char)i);
+  for (k = 1; k < 8; k++)
+    for (i = 0; i < 256; i++)
+      crc_slice[k][i] = (crc_slice[k-1][i] >> 8) ^
+	crc_slice[0][crc_slice[k-1][i] & 0xff];
+}
+
+unsigned short
+crcsum_slice8(const unsigned char* message, unsigned long length,
+	      unsigned short crc)
+{
+  while (length >= 8)
+    {
+      crc = crc_slice[7][(message[0] ^ crc) & 0xff] ^
+	crc_slice[6][(message[1] ^ (crc >> 8)) & 0xff] ^
+	crc_slice[5][message[2]] ^
+	crc_slice[4][message[3]] ^
+	crc_slice[3][message[4]] ^
+	crc_slice[2][message[5]] ^
+	crc_slice[1][message[6]] ^
+	crc_slice[0][message[7]];
+      message += 8;
+      length -= 8;
+    }
+  return crcsum_bytewise(message, length, crc);
+}
+#endif /* CRC16_HOST */
+
+#ifdef CRC16_HAVE_CLMUL
+/*
+ * Carry-less multiply folding, after Intel's "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ".  The message is kept as a 128 bit
+ * remainder in the reflected domain: bit k of the register is the
+ * coefficient of x^(127-k).  Each new 16 byte block is folded in as
+ *
+ *   X' = lo(X) * (x^192 mod P) + hi(X) * (x^128 mod P) + block
+ *
+ * A reflected carry-less product comes out multiplied by x, hence the
+ * constants are x^191 and x^127 mod P.  The last remainder is 16 ordinary
+ * message bytes, finished off with the table.
+ */
+static uint64_t crc_fold_lo;
+static uint64_t crc_fold_hi;
+
+/* x^n mod P for P = x^16 + x^12 + x^5 + 1, as a reflected 64 bit operand */
+static uint64_t
+crc_xpow_reflected(unsigned n)
+{
+  uint32_t r = 1;
+  uint64_t k = 0;
+  int d;
+
+  while (n--)
+    {
+      r <<= 1;
+      if (r & 0x10000)
+	r ^= 0x11021;
+    }
+  for (d = 0; d < 16; d++)
+    if (r & (1u << d))
+      k |= (uint64_t)1 << (63 - d);
+  return k;
+}
+
+static void
+crc_clmul_init(void)
+{
+  crc_fold_lo = crc_xpow_reflected(191);
+  crc_fold_hi = crc_xpow_reflected(127);
+}
+
+__attribute__((target("pclmul,sse2")))
+unsigned short
+crcsum_clmul(const unsigned char* message, unsigned long length,
+	     unsigned short crc)
+{
+  __m128i x, k;
+  unsigned char rest[16];
+
+  if (length < 32)
+    return crcsum_slice8(message, length, crc);
+
+  k = _mm_set_epi64x((long long)crc_fold_hi, (long long)crc_fold_lo);
+  x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)message),
+		    _mm_cvtsi32_si128(crc));
+  message += 16;
+  length -= 16;
+
+  while (length >= 16)
+    {
+      __m128i lo = _mm_clmulepi64_si128(x, k, 0x00);
+      __m128i hi = _mm_clmulepi64_si128(x, k, 0x11);
+      x = _mm_xor_si128(_mm_xor_si128(lo, hi),
+			_mm_loadu_si128((const __m128i*)message));
+      message += 16;
+      length -= 16;
+    }
+
+  _mm_storeu_si128((__m128i*)rest, x);
+  crc = crcsum_slice8(rest, 16, 0);
+  return crcsum_slice8(message, length, crc);
+}
+
+int
+crc16_clmul_supported(void)
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse2");
+}
+#endif /* CRC16_HAVE_CLMUL */
+
+#ifdef CRC16_HOST
+/*
+ * Multi-buffer verification.  A frame with its CRC appended leaves a
+ * zero register, so each lane just runs over the whole frame.  Frames
+ * are taken CRC_BATCH_CHUNK at a time and counting-sorted by length,
+ * so lanes stepping together run out within a byte or two of each
+ * other; each lane finishes its own few bytes past the shortest one.
+ * Frames longer than CRC_BATCH_SHORT go straight to crcsum.
+ */
+#define CRC_BATCH_CHUNK 256
+#define CRC_BATCH_SHORT 64
+#define CRC_LANES_MAX 8
+
+typedef void (*crc_lockstep_fn)(const unsigned char* const* lane,
+				unsigned long n, unsigned short seed,
+				unsigned short* crc);
+
+static void
+crc_batch(const unsigned char* const* frames, const unsigned long* lengths,
+	  unsigned long count, unsigned short seed, unsigned char* passed,
+	  int width, crc_lockstep_fn lockstep)
+{
+  unsigned short order[CRC_BATCH_CHUNK];
+  unsigned short start[CRC_BATCH_SHORT + 2];
+  unsigned char result[CRC_BATCH_CHUNK / 8];
+  const unsigned char* lane[CRC_LANES_MAX];
+  unsigned short crc[CRC_LANES_MAX];
+  unsigned long base, len, n;
+  unsigned j, m, g;
+  int l, lanes;
+
+  for (base = 0; base < count; base += CRC_BATCH_CHUNK)
+    {
+      const unsigned char* const* f = frames + base;
+      const unsigned long* lengthv = lengths + base;
+
+      m = (count - base < CRC_BATCH_CHUNK) ?
+	(unsigned)(count - base) : CRC_BATCH_CHUNK;
+      memset(result, 0, sizeof(result));
+      memset(start, 0, sizeof(start));
+      for (j = 0; j < m; j++)
+	{
+	  len = lengthv[j];
+	  if (len > CRC_BATCH_SHORT)
+	    {
+	      if (crcsum(f[j], len, seed) == 0)
+		result[j >> 3] |= (unsigned char)(1u << (j & 7));
+	    }
+	  else if (len >= 2)
+	    start[len + 1]++;
+	}
+      for (j = 1; j < CRC_BATCH_SHORT + 2; j++)
+	start[j] += start[j - 1];
+      for (j = 0; j < m; j++)
+	{
+	  len = lengthv[j];
+	  if (len >= 2 && len <= CRC_BATCH_SHORT)
+	    order[start[len]++] = (unsigned short)j;
+	}
+
+      for (g = 0; g < start[CRC_BATCH_SHORT]; g += lanes)
+	{
+	  lanes = width;
+	  if (g + lanes <= start[CRC_BATCH_SHORT])
+	    {
+	      for (l = 0; l < lanes; l++)
+		lane[l] = f[order[g + l]];
+	      n = lengthv[order[g]] & ~3UL;
+	      lockstep(lane, n, seed, crc);
+	    }
+	  else
+	    {
+	      lanes = (int)(start[CRC_BATCH_SHORT] - g);
+	      for (l = 0; l < lanes; l++)
+		{
+		  lane[l] = f[order[g + l]];
+		  crc[l] = seed;
+		}
+	      n = 0;
+	    }
+	  for (l = 0; l < lanes; l++)
+	    {
+	      j = order[g + l];
+	      if (crcsum_bytewise(lane[l] + n, lengthv[j] - n, crc[l]) == 0)
+		result[j >> 3] |= (unsigned char)(1u << (j & 7));
+	    }
+	}
+      memcpy(passed + base / 8, result, (m + 7) / 8);
+    }
+}
+
+/* Four message bytes as a little endian word */
+static inline uint32_t
+crc_word(const unsigned char* p)
+{
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 |
+    (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* One slice-by-4 step: fold a word into the register */
+#define CRC_SLICE4(c, w)					\
+  do								\
+    {								\
+      (c) ^= (w);						\
+      (c) = crc_slice[3][(c) & 0xff] ^				\
+	crc_slice[2][((c) >> 8) & 0xff] ^			\
+	crc_slice[1][((c) >> 16) & 0xff] ^			\
+	crc_slice[0][(c) >> 24];				\
+    }								\
+  while (0)
+
+/*
+ * Four lanes, each folding four bytes per step with slice-by-4 so the
+ * sixteen lookups of a step are independent.
+ */
+static void
+crc_lockstep_x4(const unsigned char* const* f, unsigned long n,
+		unsigned short seed, unsigned short* crc)
+{
+  uint32_t c0 = seed, c1 = seed, c2 = seed, c3 = seed;
+  unsigned long k;
+
+  for (k = 0; k < n; k += 4)
+    {
+      CRC_SLICE4(c0, crc_word(f[0] + k));
+      CRC_SLICE4(c1, crc_word(f[1] + k));
+      CRC_SLICE4(c2, crc_word(f[2] + k));
+      CRC_SLICE4(c3, crc_word(f[3] + k));
+    }
+  crc[0] = (unsigned short)c0;
+  crc[1] = (unsigned short)c1;
+  crc[2] = (unsigned short)c2;
+  crc[3] = (unsigned short)c3;
+}
+
+void
+crcverify_batch_x4(const unsigned char* const* frames,
+		   const unsigned long* lengths, unsigned long count,
+		   unsigned short seed, unsigned char* passed)
+{
+  crc_batch(frames, lengths, count, seed, passed, 4, crc_lockstep_x4);
+}
+
+#ifdef CRC16_HAVE_AVX2
+/* crc_slice[0..3] widened to 32 bits for the gathers */
+static int crc_wide[4][256];
+
+int
+crc16_avx2_supported(void)
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+/*
+ * Eight lanes, one per 32-bit element: the same slice-by-4 step as
+ * crc_lockstep_x4, as four independent gathers.
+ */
+__attribute__((target("avx2")))
+static void
+crc_lockstep_avx2(const unsigned char* const* f, unsigned long n,
+		  unsigned short seed, unsigned short* crc)
+{
+  const __m256i low = _mm256_set1_epi32(0xff);
+  __m256i c = _mm256_set1_epi32(seed);
+  unsigned long k;
+  int lane[8], l;
+
+  for (k = 0; k < n; k += 4)
+    {
+      __m256i w = _mm256_xor_si256(c, _mm256_setr_epi32(
+	(int)crc_word(f[0] + k), (int)crc_word(f[1] + k),
+	(int)crc_word(f[2] + k), (int)crc_word(f[3] + k),
+	(int)crc_word(f[4] + k), (int)crc_word(f[5] + k),
+	(int)crc_word(f[6] + k), (int)crc_word(f[7] + k)));
+      __m256i t3 = _mm256_i32gather_epi32(crc_wide[3],
+					  _mm256_and_si256(w, low), 4);
+      __m256i t2 = _mm256_i32gather_epi32(
+	crc_wide[2], _mm256_and_si256(_mm256_srli_epi32(w, 8), low), 4);
+      __m256i t1 = _mm256_i32gather_epi32(
+	crc_wide[1], _mm256_and_si256(_mm256_srli_epi32(w, 16), low), 4);
+      __m256i t0 = _mm256_i32gather_epi32(crc_wide[0],
+					  _mm256_srli_epi32(w, 24), 4);
+      c = _mm256_xor_si256(_mm256_xor_si256(t3, t2),
+			   _mm256_xor_si256(t1, t0));
+    }
+  _mm256_storeu_si256((__m256i*)lane, c);
+  for (l = 0; l < 8; l++)
+    crc[l] = (unsigned short)lane[l];
+}
+
+void
+crcverify_batch_avx2(const unsigned char* const* frames,
+		     const unsigned long* lengths, unsigned long count,
+		     unsigned short seed, unsigned char* passed)
+{
+  crc_batch(frames, lengths, count, seed, passed, 8, crc_lockstep_avx2);
+}
+#endif /* CRC16_HAVE_AVX2 */
+
+typedef void (*crc16_batch_fn)(const unsigned char* const*,
+			       const unsigned long*, unsigned long,
+			       unsigned short, unsigned char*);
+
+static crc16_batch_fn crc_batch_kernel = crcverify_batch_x4;
+
+void
+crcverify_batch(const unsigned char* const* frames,
+		const unsigned long* lengths, unsigned long count,
+		unsigned short seed, unsigned char* passed)
+{
+  crc_batch_kernel(frames, lengths, count, seed, passed);
+}
+
+typedef unsigned short (*crc16_kernel_fn)(const unsigned char*,
+					  unsigned long, unsigned short);
+
+static crc16_kernel_fn crc_kernel = crcsum_bytewise;
+static const char* crc_kernel_name = "bytewise";
+
+/* Pick the fastest kernel once, before main() */
+__attribute__((constructor))
+static void
+crc16_dispatch_init(void)
+{
+  crc_slice_init();
+  crc_kernel = crcsum_slice8;
+  crc_kernel_name = "slice8";
+#ifdef CRC16_HAVE_AVX2
+  {
+    int i, k;
+
+    for (k = 0; k < 4; k++)
+      for (i = 0; i < 256; i++)
+	crc_wide[k][i] = crc_slice[k][i];
+    if (crc16_avx2_supported())
+      crc_batch_kernel = crcverify_batch_avx2;
+  }
+#endif
+#ifdef CRC16_HAVE_CLMUL
+  crc_clmul_init();
+  if (crc16_clmul_supported())
+    {
+      crc_kernel = crcsum_clmul;
+      crc_kernel_name = "clmul";
+    }
+#endif
+}
+
+const char*
+crc16_kernel(void)
+{
+  return crc_kernel_name;
+}
+
+unsigned short
+crcsum(const unsigned char* message, unsigned long length,
+       unsigned short crc)
+{
+  return crc_kernel(message, length, crc);
+}
+#else
+unsigned short
+crcsum(const unsigned char* message, unsigned long length,
+       unsigned short crc)
+{
+  return crcsum_bytewise(message, length, crc);
+}
+#endif /* CRC16_HOST */
+
 int
 crcverify(const unsigned char* message, unsigned long length)
 {
@@ -81,3 +544,175 @@ crcappend(unsigned char* message, unsigned long length)
   message[length] = (unsigned char)(crc & 0xff);
   message[length+1] = (unsigned char)((crc >> 8) & 0xff);
 }
+
+void
+crc16_init(crc16_ctx* ctx, unsigned short seed)
+{
+  ctx->crc = seed;
+}
+
+void
+crc16_update(crc16_ctx* ctx, const unsigned char* message,
+	     unsigned long length)
+{
+  ctx->crc = crcsum(message, length, ctx->crc);
+}
+
+void
+crc16_update_byte(crc16_ctx* ctx, unsigned char c)
+{
+  unsigned short crc = ctx->crc;
+
+  CRC(crc, c);
+  ctx->crc = crc;
+}
+
+unsigned short
+crc16_final(const crc16_ctx* ctx)
+{
+  return ctx->crc;
+}
+
+int
+crc16_check(const crc16_ctx* ctx)
+{
+  /*
+   * No final xor, so running the CRC over a message followed by its
+   * own CRC leaves a zero register.
+   */
+  return ctx->crc == 0;
+}
+
+/*
+ * Combine, after zlib's crc32_combine.  Feeding lenB zero bytes through
+ * the register is a linear map on its 16 bits, so it is a 16x16 GF(2)
+ * matrix.  The matrix for one zero byte is squared up to the bits of
+ * lenB, which takes O(log lenB) steps.
+ */
+static unsigned short
+gf2_matrix_times(const unsigned short* mat, unsigned short vec)
+{
+  unsigned short sum = 0;
+
+  while (vec)
+    {
+      if (vec & 1)
+	sum ^= *mat;
+      vec >>= 1;
+      mat++;
+    }
+  return sum;
+}
+
+static void
+gf2_matrix_square(unsigned short* square, const unsigned short* mat)
+{
+  int n;
+
+  for (n = 0; n < 16; n++)
+    square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+unsigned short
+crc16_combine(unsigned short crcA, unsigned short crcB,
+	      unsigned long lenB)
+{
+  unsigned short even[16];	/* even-power-of-two zeros operator */
+  unsigned short odd[16];	/* odd-power-of-two zeros operator */
+  int n;
+
+  if (lenB == 0)
+    return crcA;
+
+  /* operator for one zero bit */
+  odd[0] = 0x8408;
+  for (n = 1; n < 16; n++)
+    odd[n] = (unsigned short)(1u << (n - 1));
+
+  gf2_matrix_square(even, odd);	/* two zero bits */
+  gf2_matrix_square(odd, even);	/* four zero bits */
+
+  /* apply lenB zero bytes to crcA, the first square is one byte */
+  do
+    {
+      gf2_matrix_square(even, odd);
+      if (lenB & 1)
+	crcA = gf2_matrix_times(even, crcA);
+      lenB >>= 1;
+      if (lenB == 0)
+	break;
+
+      gf2_matrix_square(odd, even);
+      if (lenB & 1)
+	crcA = gf2_matrix_times(odd, crcA);
+      lenB >>= 1;
+    }
+  while (lenB != 0);
+
+  return crcA ^ crcB;
+}
+
+#ifdef CRC16_HAVE_THREADS
+#define CRC16_MAX_THREADS 64
+/* below this a shard is not worth a thread */
+#define CRC16_MIN_SHARD 65536UL
+
+struct crc_shard
+{
+  const unsigned char* message;
+  unsigned long length;
+  unsigned short crc;
+  pthread_t thread;
+};
+
+static void*
+crc_shard_run(void* arg)
+{
+  struct crc_shard* shard = (struct crc_shard*)arg;
+
+  shard->crc = crcsum(shard->message, shard->length, shard->crc);
+  return NULL;
+}
+
+unsigned short
+crcsum_parallel(const unsigned char* message, unsigned long length,
+		unsigned short crc, unsigned int threads)
+{
+  struct crc_shard shards[CRC16_MAX_THREADS];
+  unsigned long step;
+  unsigned int i, started;
+
+  if (threads > CRC16_MAX_THREADS)
+    threads = CRC16_MAX_THREADS;
+  if (threads > length / CRC16_MIN_SHARD)
+    threads = (unsigned int)(length / CRC16_MIN_SHARD);
+  if (threads < 2)
+    return crcsum(message, length, crc);
+
+  step = length / threads;
+  for (i = 0; i < threads; i++)
+    {
+      shards[i].message = message + i * step;
+      shards[i].length = (i + 1 == threads) ? length - i * step : step;
+      shards[i].crc = (i == 0) ? crc : 0;
+    }
+
+  /* shard 0 runs on the calling thread */
+  for (started = 1; started < threads; started++)
+    if (pthread_create(&shards[started].thread, NULL, crc_shard_run,
+		       &shards[started]) != 0)
+      break;
+  crc_shard_run(&shards[0]);
+  for (i = started; i < threads; i++)
+    crc_shard_run(&shards[i]);
+
+  crc = shards[0].crc;
+  for (i = 1; i < threads; i++)
+    {
+      if (i < started)
+	pthread_join(shards[i].thread, NULL);
+      crc = crc16_combine(crc, shards[i].crc, shards[i].length);
+    }
+  return crc;
+}
+#endif /* CRC16_HAVE_THREADS */
@@ -1,6 +1,50 @@
 #ifndef CRC16_H
 #define CRC16_H
 
+/*
+ * Byte-at-a-time backends, chosen at compile time with CRC16_BACKEND
+ * (e.g. -DCRC16_BACKEND=CRC16_BACKEND_NIBBLE, or edit the default below).
+ *
+ *   backend   RAM    flash  lookups per byte
+ *   TABLE     512 B  512 B  1 (RAM)
+ *   PROGMEM   0      512 B  1 (pgm_read_word)
+ *   NIBBLE    0      32 B   2 (pgm_read_word)
+ *   BITWISE   0      0      none, 8 shift/xor steps
+ *
+ * Speed is in the same order, fastest first.  Run
+ * examples/Crc16Benchmark on the target for cycles per byte.
+ * AVR defaults to PROGMEM so the table stays out of SRAM.
+ */
+#define CRC16_BACKEND_TABLE   0
+#define CRC16_BACKEND_PROGMEM 1
+#define CRC16_BACKEND_NIBBLE  2
+#define CRC16_BACKEND_BITWISE 3
+
+#ifndef CRC16_BACKEND
+#ifdef __AVR__
+#define CRC16_BACKEND CRC16_BACKEND_PROGMEM
+#else
+#define CRC16_BACKEND CRC16_BACKEND_TABLE
+#endif
+#endif
+
+/*
+ * Host builds (anything that is not an Arduino sketch) get faster
+ * kernels: slice-by-8 everywhere and PCLMULQDQ folding on x86-64.  The
+ * fastest one the CPU supports is picked at start-up.  All kernels give
+ * the same result as the byte-wise kernel.
+ */
+#if !defined(ARDUINO) && !defined(__AVR__)
+#define CRC16_HOST 1
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CRC16_HAVE_CLMUL 1
+#define CRC16_HAVE_AVX2 1
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#define CRC16_HAVE_THREADS 1
+#endif
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -13,9 +57,34 @@ extern "C" {
 extern unsigned short crcsum(const unsigned char* message,
 			     unsigned long length,
 			     unsigned short crc);
+/*
+ * The CRC16_BACKEND kernel, behind crcsum on Arduino.
+ */
+extern unsigned short crcsum_bytewise(const unsigned char* message,
+				      unsigned long length,
+				      unsigned short crc);
+#ifdef CRC16_HOST
+extern unsigned short crcsum_slice8(const unsigned char* message,
+				    unsigned long length,
+				    unsigned short crc);
+/*
+ * Name of the kernel crcsum dispatches to: "slice8" or "clmul".
+ */
+extern const char* crc16_kernel(void);
+#endif
+#ifdef CRC16_HAVE_CLMUL
+/*
+ * Only call crcsum_clmul if crc16_clmul_supported() is true.
+ */
+extern unsigned short crcsum_clmul(const unsigned char* message,
+				   unsigned long length,
+				   unsigned short crc);
+extern int crc16_clmul_supported(void);
+#endif
 /*
  * Verify that the last two bytes is a (LSB first) valid CRC of the
- * message.
+ * message.  crcverify and crcappend always start from 0xFFFF; for
+ * other seeds (CRC_A is 0x6363) use crcsum, or CrcEngine.h from C++.
  */
 extern int crcverify(const unsigned char* message,
 		     unsigned long length);
@@ -27,6 +96,86 @@ extern int crcverify(const unsigned char* message,
 extern void crcappend(unsigned char* message,
 		      unsigned long length);
 
+/*
+ * Incremental CRC, for frames that are checksummed as they are sent or
+ * received rather than from one contiguous buffer:
+ *
+ *   crc16_ctx ctx;
+ *   crc16_init(&ctx, 0x6363);
+ *   crc16_update(&ctx, header, 5);
+ *   crc16_update(&ctx, payload, n);
+ *   crc = crc16_final(&ctx);
+ *
+ * To verify, update over the whole frame including its two CRC bytes
+ * (LSB first) and call crc16_check.
+ */
+typedef struct
+{
+  unsigned short crc;
+} crc16_ctx;
+
+extern void crc16_init(crc16_ctx* ctx, unsigned short seed);
+extern void crc16_update(crc16_ctx* ctx, const unsigned char* message,
+			 unsigned long length);
+extern void crc16_update_byte(crc16_ctx* ctx, unsigned char c);
+extern unsigned short crc16_final(const crc16_ctx* ctx);
+/*
+ * True if the bytes seen so far end in their own valid CRC.
+ */
+extern int crc16_check(const crc16_ctx* ctx);
+
+/*
+ * CRC of A followed by B, given crcA = crcsum(A, lenA, seed) and
+ * crcB = crcsum(B, lenB, 0).  Note crcB must use a zero seed.
+ */
+extern unsigned short crc16_combine(unsigned short crcA,
+				    unsigned short crcB,
+				    unsigned long lenB);
+#ifdef CRC16_HOST
+/*
+ * Verify count independent frames at once, each ending in its own CRC
+ * (LSB first) computed from seed.  Bit i of passed (LSB first within
+ * each byte, (count + 7) / 8 bytes) is set if frame i is valid.
+ *
+ * Short frames are dominated by per-call overhead, so several CRC
+ * streams are run side by side: eight per AVX2 register where the CPU
+ * has it, otherwise four interleaved scalar streams.  Frames are
+ * grouped by length, so mixed lengths are fine; frames over 64 bytes
+ * are checked one at a time.
+ */
+extern void crcverify_batch(const unsigned char* const* frames,
+			    const unsigned long* lengths,
+			    unsigned long count,
+			    unsigned short seed,
+			    unsigned char* passed);
+extern void crcverify_batch_x4(const unsigned char* const* frames,
+			       const unsigned long* lengths,
+			       unsigned long count,
+			       unsigned short seed,
+			       unsigned char* passed);
+#endif
+#ifdef CRC16_HAVE_AVX2
+/*
+ * Only call crcverify_batch_avx2 if crc16_avx2_supported() is true.
+ */
+extern void crcverify_batch_avx2(const unsigned char* const* frames,
+				 const unsigned long* lengths,
+				 unsigned long count,
+				 unsigned short seed,
+				 unsigned char* passed);
+extern int crc16_avx2_supported(void);
+#endif
+#ifdef CRC16_HAVE_THREADS
+/*
+ * crcsum split into shards over up to threads workers and merged with
+ * crc16_combine.  Link with -pthread.
+ */
+extern unsigned short crcsum_parallel(const unsigned char* message,
+				      unsigned long length,
+				      unsigned short crc,
+				      unsigned int threads);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,54 @@
+/*  Example: Crc16Benchmark
+ *
+ *  Measures cycles per byte of the crc16 backend this sketch was built with.
+ *  Change CRC16_BACKEND in crc16.h (TABLE, PROGMEM, NIBBLE or BITWISE) and
+ *  re-upload to compare them.
+ */
+//==============================================================================
+#include <crc16.h>
+//==============================================================================
+#define BENCH_BYTES 256
+#define BENCH_ROUNDS 64
+//==============================================================================
+unsigned char buffer[BENCH_BYTES];
+//==============================================================================
+void setup()
+{
+  Serial.begin(9600);
+  for (int i = 0; i < BENCH_BYTES; i++)
+  {
+    buffer[i] = i * 7;
+  }
+
+  Serial.print(F("backend: "));
+#if CRC16_BACKEND == CRC16_BACKEND_TABLE
+  Serial.println(F("TABLE, 512 bytes RAM"));
+#elif CRC16_BACKEND == CRC16_BACKEND_PROGMEM
+  Serial.println(F("PROGMEM, 0 bytes RAM"));
+#elif CRC16_BACKEND == CRC16_BACKEND_NIBBLE
+  Serial.println(F("NIBBLE, 0 bytes RAM"));
+#else
+  Serial.println(F("BITWISE, 0 bytes RAM"));
+#endif
+
+  // "123456789" from 0xFFFF gives the X.25 check value 0x906E before its final xor
+  unsigned short check = crcsum((const unsigned char*)"123456789", 9, 0xFFFF);
+  Serial.print(F("check: 0x"));
+  Serial.print(check, HEX);
+  Serial.println(check == 0x6F91 ? F(" ok") : F(" WRONG"));
+
+  volatile unsigned short sink = 0;
+  unsigned long start = micros();
+  for (int r = 0; r < BENCH_ROUNDS; r++)
+  {
+    sink ^= crcsum(buffer, BENCH_BYTES, 0x6363);
+  }
+  unsigned long elapsed = micros() - start;
+
+  Serial.print(F("cycles per byte: "));
+  Serial.println((float)elapsed * (F_CPU / 1000000UL) / ((unsigned long)BENCH_BYTES * BENCH_ROUNDS));
+}
+//==============================================================================
+void loop()
+{
+}
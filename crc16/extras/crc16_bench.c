@@ -0,0 +1,236 @@
+/*
+ * Throughput of the crc16 kernels on the host.
+ *
+ *   cc -O2 -pthread -I.. crc16_bench.c ../crc16.c -o crc16_bench && ./crc16_bench
+ *
+ * Checks every kernel against the byte-wise kernel first, then reports
+ * GB/s over a large buffer, and how crcsum_parallel scales with cores.
+ * Batch verification is measured in frames/s over short, mostly valid
+ * frames, against calling crcverify once per frame.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "crc16.h"
+
+#define BENCH_BYTES (64UL * 1024 * 1024)
+#define BENCH_ROUNDS 8
+#define BENCH_FRAMES (1UL << 20)
+#define BENCH_FRAME_MIN 5
+#define BENCH_FRAME_MAX 40
+
+typedef unsigned short (*kernel_fn)(const unsigned char*, unsigned long,
+				    unsigned short);
+
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int
+check(const char* name, kernel_fn kernel, const unsigned char* buf)
+{
+  unsigned long len, off;
+  unsigned short seeds[] = { 0x0000, 0x6363, 0xFFFF, 0x1234 };
+  int s;
+
+  for (len = 0; len < 600; len++)
+    for (off = 0; off < 4; off++)
+      for (s = 0; s < 4; s++)
+	if (kernel(buf + off, len, seeds[s]) !=
+	    crcsum_bytewise(buf + off, len, seeds[s]))
+	  {
+	    printf("%-8s MISMATCH len=%lu off=%lu seed=%04x\n",
+		   name, len, off, seeds[s]);
+	    return 0;
+	  }
+  return 1;
+}
+
+static void
+bench(const char* name, kernel_fn kernel, const unsigned char* buf)
+{
+  volatile unsigned short sink = 0;
+  double start, elapsed;
+  int r;
+
+  if (!check(name, kernel, buf))
+    return;
+  start = now();
+  for (r = 0; r < BENCH_ROUNDS; r++)
+    sink ^= kernel(buf, BENCH_BYTES, 0x6363);
+  elapsed = now() - start;
+  printf("%-8s %6.2f GB/s\n", name,
+	 (double)BENCH_BYTES * BENCH_ROUNDS / elapsed / 1e9);
+  (void)sink;
+}
+
+static void
+check_combine(const unsigned char* buf)
+{
+  unsigned long lenA, lenB;
+
+  for (lenA = 0; lenA < 300; lenA += 7)
+    for (lenB = 0; lenB < 3000; lenB += 13)
+      {
+	unsigned short a = crcsum(buf, lenA, 0x6363);
+	unsigned short b = crcsum(buf + lenA, lenB, 0);
+	if (crc16_combine(a, b, lenB) != crcsum(buf, lenA + lenB, 0x6363))
+	  {
+	    printf("combine MISMATCH lenA=%lu lenB=%lu\n", lenA, lenB);
+	    return;
+	  }
+      }
+  printf("combine  ok\n");
+}
+
+static void
+bench_parallel(const unsigned char* buf)
+{
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned short expected = crcsum(buf, BENCH_BYTES, 0x6363);
+  double base = 0;
+  long threads;
+
+  for (threads = 1; threads <= cores; threads *= 2)
+    {
+      volatile unsigned short sink = 0;
+      double start, elapsed, rate;
+      int r;
+
+      if (crcsum_parallel(buf, BENCH_BYTES, 0x6363, threads) != expected)
+	{
+	  printf("parallel MISMATCH threads=%ld\n", threads);
+	  return;
+	}
+      start = now();
+      for (r = 0; r < BENCH_ROUNDS; r++)
+	sink ^= crcsum_parallel(buf, BENCH_BYTES, 0x6363, threads);
+      elapsed = now() - start;
+      rate = (double)BENCH_BYTES * BENCH_ROUNDS / elapsed / 1e9;
+      if (threads == 1)
+	base = rate;
+      printf("%2ld threads %6.2f GB/s  x%.2f\n", threads, rate, rate / base);
+      (void)sink;
+      if (threads < cores && threads * 2 > cores)
+	threads = cores / 2;
+    }
+}
+
+typedef void (*batch_fn)(const unsigned char* const*, const unsigned long*,
+			 unsigned long, unsigned short, unsigned char*);
+
+static void
+bench_batch(const char* name, batch_fn batch,
+	    const unsigned char* const* frames, const unsigned long* lengths,
+	    const unsigned char* expected, unsigned char* passed)
+{
+  double start, elapsed;
+  unsigned long i;
+  int r;
+
+  /* odd counts exercise the partial groups */
+  for (i = 0; i < 40; i++)
+    {
+      unsigned long k;
+
+      batch(frames + 3, lengths + 3, i, 0xFFFF, passed);
+      for (k = 0; k < i; k++)
+	if (((passed[k >> 3] >> (k & 7)) & 1) !=
+	    ((expected[(k + 3) >> 3] >> ((k + 3) & 7)) & 1))
+	  {
+	    printf("%-8s MISMATCH count=%lu frame=%lu\n", name, i, k);
+	    return;
+	  }
+    }
+  start = now();
+  for (r = 0; r < BENCH_ROUNDS; r++)
+    batch(frames, lengths, BENCH_FRAMES, 0xFFFF, passed);
+  elapsed = now() - start;
+  for (i = 0; i < BENCH_FRAMES / 8; i++)
+    if (passed[i] != expected[i])
+      {
+	printf("%-8s MISMATCH frame=%lu\n", name, i * 8);
+	return;
+      }
+  printf("%-8s %6.2f Mframes/s\n", name,
+	 (double)BENCH_FRAMES * BENCH_ROUNDS / elapsed / 1e6);
+}
+
+static void
+bench_verify(unsigned char* buf)
+{
+  const unsigned char** frames = malloc(BENCH_FRAMES * sizeof(*frames));
+  unsigned long* lengths = malloc(BENCH_FRAMES * sizeof(*lengths));
+  unsigned char* expected = calloc(BENCH_FRAMES / 8, 1);
+  unsigned char* passed = calloc(BENCH_FRAMES / 8, 1);
+  unsigned long i, pos = 0, valid = 0;
+  double start, elapsed;
+  int r;
+
+  for (i = 0; i < BENCH_FRAMES; i++)
+    {
+      unsigned long len = BENCH_FRAME_MIN +
+	rand() % (BENCH_FRAME_MAX - BENCH_FRAME_MIN + 1);
+
+      crcappend(buf + pos, len - 2);
+      /* corrupt one frame in sixteen */
+      if (rand() % 16 == 0)
+	buf[pos + rand() % len] ^= 1 << (rand() % 8);
+      frames[i] = buf + pos;
+      lengths[i] = len;
+      pos += len;
+    }
+
+  start = now();
+  for (r = 0; r < BENCH_ROUNDS; r++)
+    for (i = 0; i < BENCH_FRAMES; i++)
+      if (crcverify(frames[i], lengths[i]))
+	expected[i >> 3] |= 1 << (i & 7);
+  elapsed = now() - start;
+  for (i = 0; i < BENCH_FRAMES; i++)
+    valid += (expected[i >> 3] >> (i & 7)) & 1;
+  printf("%lu of %lu frames valid, %d..%d bytes\n", valid, BENCH_FRAMES,
+	 BENCH_FRAME_MIN, BENCH_FRAME_MAX);
+  printf("%-8s %6.2f Mframes/s\n", "scalar",
+	 (double)BENCH_FRAMES * BENCH_ROUNDS / elapsed / 1e6);
+
+  bench_batch("x4", crcverify_batch_x4, frames, lengths, expected, passed);
+#ifdef CRC16_HAVE_AVX2
+  if (crc16_avx2_supported())
+    bench_batch("avx2", crcverify_batch_avx2, frames, lengths, expected,
+		passed);
+#endif
+  free(passed);
+  free(expected);
+  free(lengths);
+  free(frames);
+}
+
+int
+main(void)
+{
+  unsigned char* buf = malloc(BENCH_BYTES);
+  unsigned long i;
+
+  srand(1);
+  for (i = 0; i < BENCH_BYTES; i++)
+    buf[i] = (unsigned char)rand();
+
+  printf("crcsum dispatches to: %s\n", crc16_kernel());
+  bench("bytewise", crcsum_bytewise, buf);
+  bench("slice8", crcsum_slice8, buf);
+#ifdef CRC16_HAVE_CLMUL
+  if (crc16_clmul_supported())
+    bench("clmul", crcsum_clmul, buf);
+#endif
+  check_combine(buf);
+  bench_parallel(buf);
+  bench_verify(buf);
+  free(buf);
+  return 0;
+}